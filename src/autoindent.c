@@ -21,6 +21,7 @@
 #include <gtk/gtk.h>
 #include <string.h>
 #include "autoindent.h"
+#include "charclass.h"
 #include "callback.h"
 
 #define IF(c) \
@@ -63,6 +64,7 @@ autoindent_bracket_match (GtkTextBuffer *buffer, gint line, gint offset)
 {
 	GtkTextIter location, start;
 	gchar *text;
+	const gchar *p;
 	gint matched_line = line;
 	gint stack = 1;
 	gint len;
@@ -76,14 +78,15 @@ autoindent_bracket_match (GtkTextBuffer *buffer, gint line, gint offset)
 	text = gtk_text_buffer_get_text (buffer, &start, &location, 1);
 	
 	len = strlen (text);
-	for (i = len - 1; i >= 0; i--) {
-		if (text[i] == '{' && text[i + 1] != '\'') {
+	p = text + len;
+	while ((p = charclass_rfind (text, p, '{', '}', '\n')) != NULL) {
+		if (p[0] == '{' && p[1] != '\'') {
 			stack--;
 		}
-		else if (text[i] == '}' && text[i + 1] != '\'') {
+		else if (p[0] == '}' && p[1] != '\'') {
 			stack++;
 		}
-		else if (text[i] == '\n') {
+		else if (p[0] == '\n') {
 			matched_line--;
 		}
 		
@@ -94,7 +97,9 @@ autoindent_bracket_match (GtkTextBuffer *buffer, gint line, gint offset)
 		}
 	}
 	
-	for ( ; i >= 0 && text[i] != '\n'; i--);
+	i = p != NULL? p - text: -1;
+	p = charclass_rfind (text, text + i + 1, '\n', '\n', '\n');
+	i = p != NULL? p - text: -1;
 	for (i = i + 1; text[i] == '\t'; i++, tabs++);
 	
 	g_free ((gpointer) text);
@@ -112,6 +117,7 @@ autoindent_if_else_match (GtkTextBuffer *buffer, const gint line, const gint off
 {
 	GtkTextIter location, start;
 	gchar *text;
+	const gchar *p;
 	gint matched_line = line;
 	gint stack = 1;
 	gint len;
@@ -125,14 +131,15 @@ autoindent_if_else_match (GtkTextBuffer *buffer, const gint line, const gint off
 	text = gtk_text_buffer_get_text (buffer, &start, &location, 1);
 	
 	len = strlen (text);
-	for (i = len - 1; i >= 0; i--) {
-		if (IF (((gchar *)text + i))) {
+	p = text + len;
+	while ((p = charclass_rfind (text, p, 'i', 'e', '\n')) != NULL) {
+		if (IF (p)) {
 			stack--;
 		}
-		else if (ELSE (((gchar *)text + i))) {
+		else if (ELSE (p)) {
 			stack++;
 		}
-		else if (text[i] == '\n') {
+		else if (p[0] == '\n') {
 			matched_line--;
 		}
 		
@@ -143,7 +150,9 @@ autoindent_if_else_match (GtkTextBuffer *buffer, const gint line, const gint off
 		}
 	}
 	
-	for ( ; i >= 0 && text[i] != '\n'; i--);
+	i = p != NULL? p - text: -1;
+	p = charclass_rfind (text, text + i + 1, '\n', '\n', '\n');
+	i = p != NULL? p - text: -1;
 	for (i = i + 1; text[i] == '\t'; i++, tabs++);
 	
 	g_free ((gpointer) text);
@@ -39,6 +39,8 @@
 #include "project.h"
 #include "symbol.h"
 #include "search.h"
+#include "incgraph.h"
+#include "staticcheck.h"
 #include "limits.h"
 
 #define EXTRA_LENGTH 100
@@ -108,13 +110,8 @@ open_open_local_file (GtkWidget *widget, gpointer user_data)
 		exist = ui_find_editor (filepath);
 
 		if (!exist) {
-			gchar *code_buf;
-
-			misc_get_file_content (filepath, &code_buf);
-			ui_editor_new_with_text (filepath, code_buf);
+			ui_editor_new_with_file (filepath);
 			ui_status_entry_new (FILE_OP_OPEN, filepath);
-
-			g_free ((gpointer) code_buf);
 		}
 	}
 
@@ -130,6 +127,13 @@ save_save_current_code (GtkWidget *widget, gpointer user_data)
 	gchar filepath[MAX_FILEPATH_LENGTH + 1];
 	gchar *code;
 
+	/* Saving now would cut the file short at what is loaded so far. */
+	if (ui_current_editor_loading ()) {
+		ui_status_entry_new (FILE_OP_WARNING, _("file is still loading, not saved."));
+
+		return;
+	}
+
 	ui_current_editor_filepath (filepath);
 
 	if (g_strcmp0 (filepath, _("Untitled")) == 0) {
@@ -144,6 +148,8 @@ save_save_current_code (GtkWidget *widget, gpointer user_data)
 
 	code = ui_current_editor_code();
 	misc_set_file_content (filepath, code);
+	incgraph_update (filepath, code, strlen (code));
+	static_check_saved (filepath);
 	ui_save_code_post (filepath);
 	ui_status_entry_new (FILE_OP_SAVE, filepath);
 
@@ -156,12 +162,20 @@ saveas_save_to_file (GtkWidget *widget, gpointer user_data)
 	gchar filepath[MAX_FILEPATH_LENGTH + 1];
 	gchar *code;
 
+	if (ui_current_editor_loading ()) {
+		ui_status_entry_new (FILE_OP_WARNING, _("file is still loading, not saved."));
+
+		return;
+	}
+
 	filepath[0] = '\0';
 	ui_get_filepath_from_dialog (filepath, MAX_FILEPATH_LENGTH, FALSE, FALSE, filepath);
 
 	if (g_strcmp0 (filepath, "NULL") != 0) {
 		code = ui_current_editor_code();
 		misc_set_file_content (filepath, code);
+		incgraph_update (filepath, code, strlen (code));
+		static_check_saved (filepath);
 		ui_save_code_post (filepath);
 		ui_status_entry_new (FILE_OP_SAVE, filepath);
 
@@ -214,6 +228,61 @@ format_format_code (GtkWidget *widget, gpointer user_data)
 	ui_current_editor_format ();
 }
 
+void
+on_symbol_search_clicked (GtkWidget *widget, gpointer user_data)
+{
+	gchar *filepath;
+	gint line;
+
+	if (!ui_symbol_search_dialog_run (&filepath, &line)) {
+		return;
+	}
+
+	ui_editor_open_at (filepath, line);
+
+	g_free ((gpointer) filepath);
+}
+
+void
+on_xref_clicked (GtkWidget *widget, gpointer user_data)
+{
+	gchar word[MAX_VARNAME_LENGTH + 1];
+	CSymbolXref xref;
+
+	ui_current_editor_word (word, MAX_VARNAME_LENGTH);
+	if (word[0] == 0) {
+		return;
+	}
+
+	if (g_strcmp0 ((gchar *) user_data, XREF_WIDGET_CALLERS) == 0) {
+		xref = SYMBOL_XREF_CALLERS;
+	}
+	else if (g_strcmp0 ((gchar *) user_data, XREF_WIDGET_CALLEES) == 0) {
+		xref = SYMBOL_XREF_CALLEES;
+	}
+	else {
+		xref = SYMBOL_XREF_REFERENCES;
+	}
+
+	ui_reference_view_show (symbol_xref (word, xref));
+}
+
+void
+on_referencetree_activated (GtkTreeView *tree_view, GtkTreePath *path,
+							GtkTreeViewColumn *column, gpointer user_data)
+{
+	gchar *filepath;
+	gint line;
+
+	if (!ui_reference_view_get (path, &filepath, &line)) {
+		return;
+	}
+
+	ui_editor_open_at (filepath, line);
+
+	g_free ((gpointer) filepath);
+}
+
 void
 on_close_page (GtkButton *button, gpointer user_data)
 {
@@ -304,6 +373,7 @@ on_switch_page (GtkNotebook *notebook, GtkWidget *page, guint page_num,
 	ui_undo_redo_widgets_update ();
 
 	search_state_update ();
+	static_check_schedule ();
 }
 
 void
@@ -328,6 +398,23 @@ on_editor_insert (GtkTextBuffer *textbuffer, GtkTextIter *location,
 
 	ui_highlight_on_insert (textbuffer, location, linecount, &end_line);
 
+	/* Large files skip tips and member lookup and indent when idle. */
+	if (ui_current_editor_large_file ()) {
+		if ((text[0] == '\n' || text[0] == '}' || text[0] == '{') && len == 1) {
+			ui_current_editor_autoindent_later (end_line);
+		}
+
+		ui_tip_window_destory ();
+		ui_member_menu_destroy ();
+
+		ui_current_editor_set_dirty ();
+		ui_update_line_number_label (TRUE, linecount, NULL, NULL);
+		ui_current_editor_update_cursor();
+		ui_undo_redo_widgets_update ();
+
+		return;
+	}
+
 	if ((text[0] == '\n' || text[0] == '}' || text[0] == '{') && len == 1) {
 		autoindent_apply (textbuffer, location, end_line, end_line);
 	}
@@ -444,6 +531,7 @@ on_editor_delete2 (GtkTextBuffer *textbuffer, GtkTextIter *start,
 	const gchar *text;
 
 	ui_update_line_number_label (FALSE, 0, start, end);
+	ui_highlight_before_delete (textbuffer, start, end);
 
 	offset = gtk_text_iter_get_offset (start);
 	text = gtk_text_buffer_get_text (textbuffer, start, end, TRUE);
@@ -547,16 +635,12 @@ on_filetree_2clicked (GtkTreeView *tree_view, GtkTreePath *path, GtkTreeViewColu
 	ui_filetree_current_path (&filepath, &isfile);
 
 	if (isfile) {
-		gchar *code_buf;
 		gint exist;
 
 		exist = ui_find_editor (filepath);
 
 		if (!exist) {
-			misc_get_file_content (filepath, &code_buf);
-			ui_editor_new_with_text (filepath, code_buf);
-
-			g_free ((gpointer) code_buf);
+			ui_editor_new_with_file (filepath);
 		}
 		else {
 			ui_show_editor_by_path (filepath);
@@ -709,6 +793,9 @@ on_open_project (GtkWidget *widget, gpointer user_data)
 
 		ui_set_window_title (project_name);
 		ui_set_project_label (project_name);
+
+		/* Serve the saved symbols now rather than on the next tick. */
+		symbol_parse (NULL);
 	}
 }
 
@@ -730,6 +817,9 @@ on_project_settings_clicked (GtkWidget *widget, gpointer user_data)
 
 	ui_project_settings_dialog_info (libs, opts);
 	project_set_settings (libs, opts);
+	compile_static_flags_reset ();
+	static_check_reset ();
+	symbol_settings_changed ();
 	ui_project_settings_dialog_destory ();
 }
 
@@ -883,12 +973,7 @@ on_debug_action_clicked (GtkWidget *widget, gpointer user_data)
 	}
 
 	if (!ui_find_editor (filepath)) {
-		gchar *code_buf;
-
-		misc_get_file_content (filepath, &code_buf);
-		ui_editor_new_with_text (filepath, code_buf);
-
-		g_free ((gpointer) code_buf);
+		ui_editor_new_with_file (filepath);
 	}
 	ui_select_editor_with_path (filepath);
 	ui_debug_ptr_add (filepath, line);
@@ -990,6 +1075,7 @@ void
 on_textbuffer_changed (GtkTextBuffer *textbuffer, gpointer user_data)
 {
 	search_state_update ();
+	static_check_invalidate ();
 }
 
 void
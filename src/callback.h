@@ -63,6 +63,16 @@ delete_delete_code (GtkWidget *widget, gpointer user_data);
 void
 format_format_code (GtkWidget *widget, gpointer user_data);
 
+void
+on_symbol_search_clicked (GtkWidget *widget, gpointer user_data);
+
+void
+on_xref_clicked (GtkWidget *widget, gpointer user_data);
+
+void
+on_referencetree_activated (GtkTreeView *tree_view, GtkTreePath *path,
+							GtkTreeViewColumn *column, gpointer user_data);
+
 void
 build_compile (GtkWidget *widget, gpointer user_data);
 
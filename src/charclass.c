@@ -0,0 +1,470 @@
+/*
+ * charclass.c
+ * This file is part of codefox
+ *
+ * Copyright (C) 2012-2017 - Gordon Li
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <gtk/gtk.h>
+
+#include "charclass.h"
+
+#if defined (__GNUC__) && (defined (__x86_64__) || defined (__i386__))
+# define CHARCLASS_X86 1
+# include <immintrin.h>
+#endif
+
+/* Bytes tested one by one before a kernel switches to vectors. */
+#define CHARCLASS_PREFIX 8
+
+const guint8 charclass_table[256] = {
+	0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 2, 0, 0, 0, 0, 0,
+	0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+	0, 0, 2, 1, 0, 0, 0, 2, 0, 0, 0, 0, 0, 0, 1, 2,
+	1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 0, 0, 0, 0, 0, 0,
+	0, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1,
+	1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 0, 0, 0, 0, 1,
+	0, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1,
+	1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 0, 0, 0, 0, 0,
+	1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1,
+	1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1,
+	1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1,
+	1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1,
+	1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1,
+	1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1,
+	1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1,
+	1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1,
+};
+
+typedef struct {
+	const gchar *(*skip_ident) (const gchar *, const gchar *);
+	const gchar *(*skip_neutral) (const gchar *, const gchar *);
+	const gchar *(*find) (const gchar *, const gchar *, const gchar, const gchar, const gchar);
+	const gchar *(*rfind) (const gchar *, const gchar *, const gchar, const gchar, const gchar);
+} CCharClassKernels;
+
+static const gchar *
+charclass_skip_ident_scalar (const gchar *p, const gchar *end)
+{
+	while (p < end && (charclass_table[(guchar) *p] & CHARCLASS_IDENT)) {
+		p++;
+	}
+
+	return p;
+}
+
+static const gchar *
+charclass_skip_neutral_scalar (const gchar *p, const gchar *end)
+{
+	while (p < end && !charclass_table[(guchar) *p]) {
+		p++;
+	}
+
+	return p;
+}
+
+static const gchar *
+charclass_find_scalar (const gchar *p, const gchar *end, const gchar a,
+					   const gchar b, const gchar c)
+{
+	while (p < end && *p != a && *p != b && *p != c) {
+		p++;
+	}
+
+	return p;
+}
+
+static const gchar *
+charclass_rfind_scalar (const gchar *start, const gchar *p, const gchar a,
+						const gchar b, const gchar c)
+{
+	while (p > start) {
+		p--;
+		if (*p == a || *p == b || *p == c) {
+			return p;
+		}
+	}
+
+	return NULL;
+}
+
+#ifdef CHARCLASS_X86
+
+/* Bytes are compared as signed, so those of non-ASCII characters are the
+ * negative ones.
+ */
+__attribute__ ((target ("sse2")))
+static inline __m128i
+charclass_ident_sse2 (const __m128i v)
+{
+	__m128i lower, alpha, digit, misc;
+
+	lower = _mm_or_si128 (v, _mm_set1_epi8 (0x20));
+	alpha = _mm_and_si128 (_mm_cmpgt_epi8 (lower, _mm_set1_epi8 ('a' - 1)),
+						   _mm_cmplt_epi8 (lower, _mm_set1_epi8 ('z' + 1)));
+	digit = _mm_and_si128 (_mm_cmpgt_epi8 (v, _mm_set1_epi8 ('0' - 1)),
+						   _mm_cmplt_epi8 (v, _mm_set1_epi8 ('9' + 1)));
+	misc = _mm_or_si128 (_mm_or_si128 (_mm_cmpeq_epi8 (v, _mm_set1_epi8 ('_')),
+									   _mm_cmpeq_epi8 (v, _mm_set1_epi8 ('#'))),
+						 _mm_or_si128 (_mm_cmpeq_epi8 (v, _mm_set1_epi8 ('.')),
+									   _mm_cmplt_epi8 (v, _mm_setzero_si128 ())));
+
+	return _mm_or_si128 (_mm_or_si128 (alpha, digit), misc);
+}
+
+__attribute__ ((target ("sse2")))
+static inline __m128i
+charclass_special_sse2 (const __m128i v)
+{
+	return _mm_or_si128 (_mm_or_si128 (_mm_cmpeq_epi8 (v, _mm_set1_epi8 ('\"')),
+									   _mm_cmpeq_epi8 (v, _mm_set1_epi8 ('\''))),
+						 _mm_or_si128 (_mm_cmpeq_epi8 (v, _mm_set1_epi8 ('/')),
+									   _mm_cmpeq_epi8 (v, _mm_set1_epi8 ('\n'))));
+}
+
+__attribute__ ((target ("sse2")))
+static inline __m128i
+charclass_any_sse2 (const __m128i v, const gchar a, const gchar b, const gchar c)
+{
+	return _mm_or_si128 (_mm_or_si128 (_mm_cmpeq_epi8 (v, _mm_set1_epi8 (a)),
+									   _mm_cmpeq_epi8 (v, _mm_set1_epi8 (b))),
+						 _mm_cmpeq_epi8 (v, _mm_set1_epi8 (c)));
+}
+
+__attribute__ ((target ("sse2")))
+static const gchar *
+charclass_skip_ident_sse2 (const gchar *p, const gchar *end)
+{
+	const gchar *q;
+
+	/* Most runs are short, vectors only pay off past the first bytes. */
+	q = charclass_skip_ident_scalar (p, MIN (end, p + CHARCLASS_PREFIX));
+	if (q < end && q < p + CHARCLASS_PREFIX) {
+		return q;
+	}
+	p = q;
+
+	while (end - p >= 16) {
+		guint mask;
+
+		mask = _mm_movemask_epi8 (charclass_ident_sse2 (_mm_loadu_si128 ((const __m128i *) p)));
+		if (mask != 0xffff) {
+			return p + __builtin_ctz (~mask);
+		}
+		p += 16;
+	}
+
+	return charclass_skip_ident_scalar (p, end);
+}
+
+__attribute__ ((target ("sse2")))
+static const gchar *
+charclass_skip_neutral_sse2 (const gchar *p, const gchar *end)
+{
+	const gchar *q;
+
+	/* Most runs are short, vectors only pay off past the first bytes. */
+	q = charclass_skip_neutral_scalar (p, MIN (end, p + CHARCLASS_PREFIX));
+	if (q < end && q < p + CHARCLASS_PREFIX) {
+		return q;
+	}
+	p = q;
+
+	while (end - p >= 16) {
+		__m128i v;
+		guint mask;
+
+		v = _mm_loadu_si128 ((const __m128i *) p);
+		mask = _mm_movemask_epi8 (_mm_or_si128 (charclass_ident_sse2 (v),
+												charclass_special_sse2 (v)));
+		if (mask != 0) {
+			return p + __builtin_ctz (mask);
+		}
+		p += 16;
+	}
+
+	return charclass_skip_neutral_scalar (p, end);
+}
+
+__attribute__ ((target ("sse2")))
+static const gchar *
+charclass_find_sse2 (const gchar *p, const gchar *end, const gchar a,
+					 const gchar b, const gchar c)
+{
+	const gchar *q;
+
+	q = charclass_find_scalar (p, MIN (end, p + CHARCLASS_PREFIX), a, b, c);
+	if (q < end && q < p + CHARCLASS_PREFIX) {
+		return q;
+	}
+	p = q;
+
+	while (end - p >= 16) {
+		guint mask;
+
+		mask = _mm_movemask_epi8 (charclass_any_sse2 (_mm_loadu_si128 ((const __m128i *) p), a, b, c));
+		if (mask != 0) {
+			return p + __builtin_ctz (mask);
+		}
+		p += 16;
+	}
+
+	return charclass_find_scalar (p, end, a, b, c);
+}
+
+__attribute__ ((target ("sse2")))
+static const gchar *
+charclass_rfind_sse2 (const gchar *start, const gchar *p, const gchar a,
+					  const gchar b, const gchar c)
+{
+	while (p - start >= 16) {
+		guint mask;
+
+		p -= 16;
+		mask = _mm_movemask_epi8 (charclass_any_sse2 (_mm_loadu_si128 ((const __m128i *) p), a, b, c));
+		if (mask != 0) {
+			return p + 31 - __builtin_clz (mask);
+		}
+	}
+
+	return charclass_rfind_scalar (start, p, a, b, c);
+}
+
+__attribute__ ((target ("avx2")))
+static inline __m256i
+charclass_ident_avx2 (const __m256i v)
+{
+	__m256i lower, alpha, digit, misc;
+
+	lower = _mm256_or_si256 (v, _mm256_set1_epi8 (0x20));
+	alpha = _mm256_and_si256 (_mm256_cmpgt_epi8 (lower, _mm256_set1_epi8 ('a' - 1)),
+							  _mm256_cmpgt_epi8 (_mm256_set1_epi8 ('z' + 1), lower));
+	digit = _mm256_and_si256 (_mm256_cmpgt_epi8 (v, _mm256_set1_epi8 ('0' - 1)),
+							  _mm256_cmpgt_epi8 (_mm256_set1_epi8 ('9' + 1), v));
+	misc = _mm256_or_si256 (_mm256_or_si256 (_mm256_cmpeq_epi8 (v, _mm256_set1_epi8 ('_')),
+											 _mm256_cmpeq_epi8 (v, _mm256_set1_epi8 ('#'))),
+							_mm256_or_si256 (_mm256_cmpeq_epi8 (v, _mm256_set1_epi8 ('.')),
+											 _mm256_cmpgt_epi8 (_mm256_setzero_si256 (), v)));
+
+	return _mm256_or_si256 (_mm256_or_si256 (alpha, digit), misc);
+}
+
+__attribute__ ((target ("avx2")))
+static inline __m256i
+charclass_special_avx2 (const __m256i v)
+{
+	return _mm256_or_si256 (_mm256_or_si256 (_mm256_cmpeq_epi8 (v, _mm256_set1_epi8 ('\"')),
+											 _mm256_cmpeq_epi8 (v, _mm256_set1_epi8 ('\''))),
+							_mm256_or_si256 (_mm256_cmpeq_epi8 (v, _mm256_set1_epi8 ('/')),
+											 _mm256_cmpeq_epi8 (v, _mm256_set1_epi8 ('\n'))));
+}
+
+__attribute__ ((target ("avx2")))
+static inline __m256i
+charclass_any_avx2 (const __m256i v, const gchar a, const gchar b, const gchar c)
+{
+	return _mm256_or_si256 (_mm256_or_si256 (_mm256_cmpeq_epi8 (v, _mm256_set1_epi8 (a)),
+											 _mm256_cmpeq_epi8 (v, _mm256_set1_epi8 (b))),
+							_mm256_cmpeq_epi8 (v, _mm256_set1_epi8 (c)));
+}
+
+__attribute__ ((target ("avx2")))
+static const gchar *
+charclass_skip_ident_avx2 (const gchar *p, const gchar *end)
+{
+	const gchar *q;
+
+	/* Most runs are short, vectors only pay off past the first bytes. */
+	q = charclass_skip_ident_scalar (p, MIN (end, p + CHARCLASS_PREFIX));
+	if (q < end && q < p + CHARCLASS_PREFIX) {
+		return q;
+	}
+	p = q;
+
+	while (end - p >= 32) {
+		guint mask;
+
+		mask = _mm256_movemask_epi8 (charclass_ident_avx2 (_mm256_loadu_si256 ((const __m256i *) p)));
+		if (mask != 0xffffffff) {
+			return p + __builtin_ctz (~mask);
+		}
+		p += 32;
+	}
+
+	return charclass_skip_ident_sse2 (p, end);
+}
+
+__attribute__ ((target ("avx2")))
+static const gchar *
+charclass_skip_neutral_avx2 (const gchar *p, const gchar *end)
+{
+	const gchar *q;
+
+	/* Most runs are short, vectors only pay off past the first bytes. */
+	q = charclass_skip_neutral_scalar (p, MIN (end, p + CHARCLASS_PREFIX));
+	if (q < end && q < p + CHARCLASS_PREFIX) {
+		return q;
+	}
+	p = q;
+
+	while (end - p >= 32) {
+		__m256i v;
+		guint mask;
+
+		v = _mm256_loadu_si256 ((const __m256i *) p);
+		mask = _mm256_movemask_epi8 (_mm256_or_si256 (charclass_ident_avx2 (v),
+													  charclass_special_avx2 (v)));
+		if (mask != 0) {
+			return p + __builtin_ctz (mask);
+		}
+		p += 32;
+	}
+
+	return charclass_skip_neutral_sse2 (p, end);
+}
+
+__attribute__ ((target ("avx2")))
+static const gchar *
+charclass_find_avx2 (const gchar *p, const gchar *end, const gchar a,
+					 const gchar b, const gchar c)
+{
+	const gchar *q;
+
+	q = charclass_find_scalar (p, MIN (end, p + CHARCLASS_PREFIX), a, b, c);
+	if (q < end && q < p + CHARCLASS_PREFIX) {
+		return q;
+	}
+	p = q;
+
+	while (end - p >= 32) {
+		guint mask;
+
+		mask = _mm256_movemask_epi8 (charclass_any_avx2 (_mm256_loadu_si256 ((const __m256i *) p), a, b, c));
+		if (mask != 0) {
+			return p + __builtin_ctz (mask);
+		}
+		p += 32;
+	}
+
+	return charclass_find_sse2 (p, end, a, b, c);
+}
+
+__attribute__ ((target ("avx2")))
+static const gchar *
+charclass_rfind_avx2 (const gchar *start, const gchar *p, const gchar a,
+					  const gchar b, const gchar c)
+{
+	while (p - start >= 32) {
+		guint mask;
+
+		p -= 32;
+		mask = _mm256_movemask_epi8 (charclass_any_avx2 (_mm256_loadu_si256 ((const __m256i *) p), a, b, c));
+		if (mask != 0) {
+			return p + 31 - __builtin_clz (mask);
+		}
+	}
+
+	return charclass_rfind_sse2 (start, p, a, b, c);
+}
+
+#endif /* CHARCLASS_X86 */
+
+static const CCharClassKernels charclass_kernels[] = {
+	{
+		charclass_skip_ident_scalar,
+		charclass_skip_neutral_scalar,
+		charclass_find_scalar,
+		charclass_rfind_scalar
+	},
+#ifdef CHARCLASS_X86
+	{
+		charclass_skip_ident_sse2,
+		charclass_skip_neutral_sse2,
+		charclass_find_sse2,
+		charclass_rfind_sse2
+	},
+	{
+		charclass_skip_ident_avx2,
+		charclass_skip_neutral_avx2,
+		charclass_find_avx2,
+		charclass_rfind_avx2
+	}
+#endif
+};
+
+static const CCharClassKernels *kernels = &charclass_kernels[CHARCLASS_LEVEL_SCALAR];
+
+void
+charclass_init ()
+{
+	charclass_set_level (CHARCLASS_LEVEL_AVX2);
+}
+
+/* Use the fastest kernels up to level that the CPU runs, and return the
+ * level actually used. Call it before any lexing thread starts.
+ */
+gint
+charclass_set_level (const gint level)
+{
+	gint used;
+
+	used = CHARCLASS_LEVEL_SCALAR;
+
+#ifdef CHARCLASS_X86
+	__builtin_cpu_init ();
+
+	if (level >= CHARCLASS_LEVEL_AVX2 && __builtin_cpu_supports ("avx2")) {
+		used = CHARCLASS_LEVEL_AVX2;
+	}
+	else if (level >= CHARCLASS_LEVEL_SSE2 && __builtin_cpu_supports ("sse2")) {
+		used = CHARCLASS_LEVEL_SSE2;
+	}
+#endif
+
+	kernels = &charclass_kernels[used];
+
+	return used;
+}
+
+/* First byte in [p, end) that is not of CHARCLASS_IDENT, or end. */
+const gchar *
+charclass_skip_ident (const gchar *p, const gchar *end)
+{
+	return kernels->skip_ident (p, end);
+}
+
+/* First byte in [p, end) of CHARCLASS_IDENT or CHARCLASS_SPECIAL, or end. */
+const gchar *
+charclass_skip_neutral (const gchar *p, const gchar *end)
+{
+	return kernels->skip_neutral (p, end);
+}
+
+/* First byte in [p, end) equal to a, b or c, or end. */
+const gchar *
+charclass_find (const gchar *p, const gchar *end, const gchar a,
+				const gchar b, const gchar c)
+{
+	return kernels->find (p, end, a, b, c);
+}
+
+/* Last byte in [start, p) equal to a, b or c, or NULL. */
+const gchar *
+charclass_rfind (const gchar *start, const gchar *p, const gchar a,
+				 const gchar b, const gchar c)
+{
+	return kernels->rfind (start, p, a, b, c);
+}
@@ -0,0 +1,61 @@
+/*
+ * charclass.h
+ * This file is part of codefox
+ *
+ * Copyright (C) 2012-2017 - Gordon Li
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef CHARCLASS_H
+#define CHARCLASS_H
+
+#include <gtk/gtk.h>
+
+/* Letters, digits, '_', '#', '.' and bytes of non-ASCII characters. */
+#define CHARCLASS_IDENT 1
+
+/* Bytes the highlighter has to look at out of a token: '"', '\'', '/', '\n'. */
+#define CHARCLASS_SPECIAL 2
+
+#define CHARCLASS_IS_IDENT(c) (charclass_table[(guchar) (c)] & CHARCLASS_IDENT)
+
+/* Kernel sets, see charclass_set_level (). */
+#define CHARCLASS_LEVEL_SCALAR 0
+#define CHARCLASS_LEVEL_SSE2 1
+#define CHARCLASS_LEVEL_AVX2 2
+
+extern const guint8 charclass_table[256];
+
+void
+charclass_init ();
+
+gint
+charclass_set_level (const gint level);
+
+const gchar *
+charclass_skip_ident (const gchar *p, const gchar *end);
+
+const gchar *
+charclass_skip_neutral (const gchar *p, const gchar *end);
+
+const gchar *
+charclass_find (const gchar *p, const gchar *end, const gchar a,
+				const gchar b, const gchar c);
+
+const gchar *
+charclass_rfind (const gchar *start, const gchar *p, const gchar a,
+				 const gchar b, const gchar c);
+
+#endif /* CHARCLASS_H */
@@ -0,0 +1,235 @@
+/*
+ * charclassbench.c
+ * This file is part of codefox
+ *
+ * Copyright (C) 2012-2017 - Gordon Li
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/* Micro-benchmark of the character class kernels used by the highlighter,
+ * against the byte by byte macro tests they replaced. Run it as
+ * "charclassbench [FILE]", a generated C source is scanned without FILE.
+ */
+
+#include <stdio.h>
+#include <string.h>
+
+#include <gtk/gtk.h>
+
+#include "charclass.h"
+
+#if defined (__GNUC__) && (defined (__x86_64__) || defined (__i386__))
+# include <x86intrin.h>
+# define BENCH_CLOCK() __rdtsc ()
+# define BENCH_UNIT "bytes/cycle"
+#else
+# define BENCH_CLOCK() (g_get_monotonic_time () * 1000)
+# define BENCH_UNIT "bytes/ns"
+#endif
+
+#define BENCH_ROUNDS 20
+
+/* The tests of the old highlighter loop. */
+#define CHAR(c) ((c >= 'a' && c <= 'z') || \
+ (c >= 'A' && c <= 'Z') || c == '#' || c == '_')
+
+#define DIGIT(c) ((c >= '0' && c <= '9') || c == '.')
+
+static const gchar *levels[] = {"scalar", "sse2", "avx2"};
+
+static gchar *
+bench_generate (gsize *len)
+{
+	GString *code;
+	gint i;
+
+	code = g_string_new (NULL);
+	for (i = 0; code->len < 8 * 1024 * 1024; i++) {
+		g_string_append_printf (code,
+								"/* Function number %d, with a comment that\n"
+								" * goes over two lines. */\n"
+								"static int\n"
+								"function_%d (const char *name, int value)\n"
+								"{\n"
+								"\tint result = value * %d + 0x%x;\n\n"
+								"\tif (name != NULL && name[0] == '\\'') {\n"
+								"\t\tprintf (\"%%s: \\\"%%d\\\"\\n\", name, result); // trace\n"
+								"\t}\n\n"
+								"\treturn result;\n"
+								"}\n\n", i, i, i, i);
+	}
+
+	*len = code->len;
+
+	return g_string_free (code, FALSE);
+}
+
+static gsize
+bench_macro (const gchar *text, const gsize len)
+{
+	gsize i;
+	gsize tokens;
+
+	tokens = 0;
+	for (i = 0; i < len; i++) {
+		if (!CHAR (text[i]) && !DIGIT (text[i]) && text[i] > 0) {
+			tokens++;
+		}
+	}
+
+	return tokens;
+}
+
+static gsize
+bench_table (const gchar *text, const gsize len)
+{
+	gsize i;
+	gsize tokens;
+
+	tokens = 0;
+	for (i = 0; i < len; i++) {
+		if (!CHARCLASS_IS_IDENT (text[i])) {
+			tokens++;
+		}
+	}
+
+	return tokens;
+}
+
+static gsize
+bench_skip (const gchar *text, const gsize len)
+{
+	const gchar *p, *end;
+	gsize tokens;
+
+	p = text;
+	end = text + len;
+	tokens = 0;
+	while (p < end) {
+		p = charclass_skip_ident (p, end);
+		p = charclass_skip_neutral (p + 1, end);
+		tokens++;
+	}
+
+	return tokens;
+}
+
+static gsize
+bench_find_quote (const gchar *text, const gsize len)
+{
+	const gchar *p, *end;
+	gsize found;
+
+	p = text;
+	end = text + len;
+	found = 0;
+	while ((p = charclass_find (p, end, '\"', '\\', '\n')) < end) {
+		p++;
+		found++;
+	}
+
+	return found;
+}
+
+static gsize
+bench_find_comment_end (const gchar *text, const gsize len)
+{
+	const gchar *p, *end;
+	gsize found;
+
+	p = text;
+	end = text + len;
+	found = 0;
+	while ((p = charclass_find (p, end, '/', '\n', '\n')) < end) {
+		p++;
+		found++;
+	}
+
+	return found;
+}
+
+static void
+bench_run (const gchar *name, gsize (*scan) (const gchar *, const gsize),
+		   const gchar *text, const gsize len)
+{
+	guint64 best;
+	gsize result;
+	gint i;
+
+	best = G_MAXUINT64;
+	result = 0;
+	for (i = 0; i < BENCH_ROUNDS; i++) {
+		guint64 start;
+		guint64 cycles;
+
+		start = BENCH_CLOCK ();
+		result = scan (text, len);
+		cycles = BENCH_CLOCK () - start;
+		best = MIN (best, MAX (cycles, 1));
+	}
+
+	printf ("%-24s %8.3f %s (%" G_GSIZE_FORMAT ")\n", name,
+			(gdouble) len / best, BENCH_UNIT, result);
+}
+
+int
+main (int argc, char *argv[])
+{
+	gchar *text;
+	gsize len;
+	gint level;
+
+	if (argc > 1) {
+		if (!g_file_get_contents (argv[1], &text, &len, NULL)) {
+			fprintf (stderr, "can't read %s.\n", argv[1]);
+
+			return 1;
+		}
+	}
+	else {
+		text = bench_generate (&len);
+	}
+
+	printf ("%" G_GSIZE_FORMAT " bytes\n", len);
+
+	bench_run ("macro", bench_macro, text, len);
+	bench_run ("table", bench_table, text, len);
+
+	for (level = CHARCLASS_LEVEL_SCALAR; level <= CHARCLASS_LEVEL_AVX2; level++) {
+		gchar *name;
+
+		if (charclass_set_level (level) != level) {
+			printf ("%s not supported.\n", levels[level]);
+
+			continue;
+		}
+
+		name = g_strdup_printf ("skip/%s", levels[level]);
+		bench_run (name, bench_skip, text, len);
+		g_free ((gpointer) name);
+
+		name = g_strdup_printf ("find-quote/%s", levels[level]);
+		bench_run (name, bench_find_quote, text, len);
+		g_free ((gpointer) name);
+
+		name = g_strdup_printf ("find-comment-end/%s", levels[level]);
+		bench_run (name, bench_find_comment_end, text, len);
+		g_free ((gpointer) name);
+	}
+
+	g_free ((gpointer) text);
+
+	return 0;
+}
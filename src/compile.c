@@ -23,6 +23,7 @@
 # include "config.h"
 #endif
 
+#include <signal.h>
 #include <glib/gi18n-lib.h>
 #include <glib.h>
 #include "compile.h"
@@ -34,6 +35,18 @@ static gboolean done;
 static gint offset;
 static GMutex compile_mutex;
 
+/* The compiler of the running static check, 0 if there is none. It leads
+ * its own process group, so the cc1 under it goes with it.
+ */
+static GPid compile_static_pid;
+static gboolean compile_static_cancelled;
+static GMutex compile_static_mutex;
+
+/* pkg-config --cflags of compile_flags_libs, split into arguments. */
+static gchar *compile_flags_libs;
+static gchar **compile_flags;
+static GMutex compile_flags_mutex;
+
 static gpointer 
 compile_compile (gpointer data)
 {
@@ -176,38 +189,151 @@ compile_current_project (const gchar *path, const gboolean compile)
 	}
 }
 
+/* Adds the pkg-config flags of libs to argv. They are looked up once per
+ * libs string, until compile_static_flags_reset.
+ */
+static void
+compile_static_flags (GPtrArray *argv, const gchar *libs)
+{
+	gint i;
+
+	g_mutex_lock (&compile_flags_mutex);
+
+	if (compile_flags == NULL || g_strcmp0 (libs, compile_flags_libs) != 0) {
+		gchar *command;
+		gchar *cflags;
+		gint status;
+
+		g_strfreev (compile_flags);
+		compile_flags = NULL;
+		g_free ((gpointer) compile_flags_libs);
+		compile_flags_libs = g_strdup (libs);
+
+		command = g_strdup_printf ("pkg-config --cflags %s", libs);
+		cflags = NULL;
+		if (g_spawn_command_line_sync (command, &cflags, NULL, &status, NULL) && status == 0) {
+			g_shell_parse_argv (g_strstrip (cflags), NULL, &compile_flags, NULL);
+		}
+		else {
+			g_warning ("pkg-config failed for %s.", libs);
+		}
+		if (compile_flags == NULL) {
+			compile_flags = g_new0 (gchar *, 1);
+		}
+
+		g_free ((gpointer) cflags);
+		g_free ((gpointer) command);
+	}
+
+	for (i = 0; compile_flags[i]; i++) {
+		g_ptr_array_add (argv, g_strdup (compile_flags[i]));
+	}
+
+	g_mutex_unlock (&compile_flags_mutex);
+}
+
+/* Forgets the cached pkg-config flags, for when the settings were saved. */
 void
-compile_static_check (const gchar *filepath, const gint type, const gchar *libs, gchar *output)
+compile_static_flags_reset ()
 {
-	FILE *pi;
-	gchar line[MAX_LINE_LENGTH + 1];
-	gchar command[MAX_LINE_LENGTH + 1];
+	g_mutex_lock (&compile_flags_mutex);
+	g_strfreev (compile_flags);
+	compile_flags = NULL;
+	g_free ((gpointer) compile_flags_libs);
+	compile_flags_libs = NULL;
+	g_mutex_unlock (&compile_flags_mutex);
+}
 
-	fflush (stdin);
+static void
+compile_static_setup (gpointer data)
+{
+	setpgid (0, 0);
+}
 
-	g_strlcpy (command, type? "g++ -S -Wall ": "gcc -S -Wall ", MAX_LINE_LENGTH);
-	if (strlen (libs) > 0) {
-		g_strlcat (command, "`pkg-config --cflags ", MAX_LINE_LENGTH);
-		g_strlcat (command, libs, MAX_LINE_LENGTH);
-		g_strlcat (command, "` ", MAX_LINE_LENGTH);
+/* Runs on the static check worker, compile_static_cancel may end the
+ * compiler early from the main loop, leaving output incomplete.
+ */
+void
+compile_static_check (const gchar *filepath, const gint type, const gchar *libs, gchar *output)
+{
+	GPtrArray *argv;
+	GPid pid;
+	gint out;
+	gint len;
+	gssize n;
+	gboolean spawned;
+	gint64 start;
+
+	start = g_get_monotonic_time ();
+
+	/* Diagnostics only, the compiler stops after parsing. */
+	argv = g_ptr_array_new_with_free_func (g_free);
+	g_ptr_array_add (argv, g_strdup (type? "g++": "gcc"));
+	g_ptr_array_add (argv, g_strdup ("-fsyntax-only"));
+	g_ptr_array_add (argv, g_strdup ("-Wall"));
+	if (strlen (libs) > 0 && env_prog_exist (ENV_PROG_PKG_CONFIG)) {
+		compile_static_flags (argv, libs);
 	}
-	g_strlcat (command, filepath, MAX_LINE_LENGTH);
-	g_strlcat (command, " 2>&1", MAX_LINE_LENGTH);
+	g_ptr_array_add (argv, g_strdup (filepath));
+	g_ptr_array_add (argv, NULL);
 
 	output[0] = 0;
 
-	pi = popen (command, "r");
+	g_mutex_lock (&compile_static_mutex);
+	spawned = g_spawn_async_with_pipes (NULL, (gchar **) argv->pdata, NULL,
+										G_SPAWN_SEARCH_PATH | G_SPAWN_DO_NOT_REAP_CHILD |
+										G_SPAWN_STDOUT_TO_DEV_NULL,
+										compile_static_setup, NULL, &pid, NULL, NULL, &out, NULL);
+	if (spawned) {
+		compile_static_pid = pid;
+		compile_static_cancelled = FALSE;
+	}
+	g_mutex_unlock (&compile_static_mutex);
+	g_ptr_array_free (argv, TRUE);
+
+	if (!spawned) {
+		g_warning ("can't spawn static check.");
 
-	if (pi == NULL) {
-		g_error ("can't open pipe for make.");
-		
 		return;
 	}
-	while (fgets (line, MAX_LINE_LENGTH, pi)) {
-		g_strlcat (output, line, MAX_RESULT_LENGTH);
+
+	/* A cancel kills every writer of the pipe, so the read ends at once;
+	 * whatever still arrives after it is not worth waiting for.
+	 */
+	len = 0;
+	while ((n = read (out, output + len, MAX_RESULT_LENGTH - len)) > 0) {
+		len += n;
+		if (g_atomic_int_get (&compile_static_cancelled)) {
+			break;
+		}
 	}
+	output[len] = 0;
+	close (out);
 
-	pclose (pi);
+	/* Until it is reaped the pid can not be reused, so a kill that still
+	 * sees it can not hit another process.
+	 */
+	g_mutex_lock (&compile_static_mutex);
+	compile_static_pid = 0;
+	g_mutex_unlock (&compile_static_mutex);
+
+	waitpid (pid, NULL, 0);
+	g_spawn_close_pid (pid);
+
+	g_debug ("static check: %s in %" G_GINT64_FORMAT " us.", filepath,
+			 g_get_monotonic_time () - start);
+}
+
+/* Ends the compiler of the running static check, if any. */
+void
+compile_static_cancel ()
+{
+	g_mutex_lock (&compile_static_mutex);
+	if (compile_static_pid != 0) {
+		g_atomic_int_set (&compile_static_cancelled, TRUE);
+		kill (-compile_static_pid, SIGTERM);
+	}
+	g_mutex_unlock (&compile_static_mutex);
 }
 
 gint
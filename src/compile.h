@@ -38,6 +38,12 @@ compile_done ();
 void
 compile_static_check (const gchar *filepath, const gint type, const gchar *libs, gchar *output);
 
+void
+compile_static_cancel ();
+
+void
+compile_static_flags_reset ();
+
 gint
 compile_is_error (gchar *output);
 
@@ -30,11 +30,16 @@
 
 #include "editor.h"
 #include "callback.h"
+#include "autoindent.h"
+#include "editorconfig.h"
 #include "limits.h"
 
 #define MAX_LINE_NUMBER_LENGTH 20
 #define MAX_LINE_BUFFER_SIZE 100000
 
+/* Bytes of a large file appended to its buffer per idle call. */
+#define EDITOR_LOAD_CHUNK (1 << 20)
+
 static GList *breakpoint_list;
 
 static void ceditor_set_tabs (GtkWidget *textview);
@@ -187,6 +192,8 @@ ceditor_init (CEditor *new_editor, const gchar *label)
 	gtk_widget_add_events (GTK_WIDGET (new_editor->textview), GDK_KEY_PRESS_MASK);
 	
 	highlight_register (GTK_TEXT_BUFFER (gtk_text_view_get_buffer (GTK_TEXT_VIEW (new_editor->textview))));
+	new_editor->highlight_cache = highlight_cache_new (GTK_TEXT_VIEW (new_editor->textview));
+	new_editor->local_index = localdecl_new (gtk_text_view_get_buffer (GTK_TEXT_VIEW (new_editor->textview)));
 
 	ceditor_search_init (new_editor, 0);
 }
@@ -209,12 +216,32 @@ ceditor_new (const gchar *label)
 	return new_editor;
 }
 
+static gboolean
+ceditor_is_large (const gint64 size, const gint lines)
+{
+	const CEditorConfig *editor_config;
+
+	editor_config = editorconfig_config_get ();
+
+	return size > editor_config->large_file_size || lines > editor_config->large_file_lines;
+}
+
+static void
+ceditor_set_large_file (CEditor *editor)
+{
+	/* Large files go without line numbers, highlighting and local symbols. */
+	editor->large_file = TRUE;
+	highlight_cache_free (editor->highlight_cache);
+	editor->highlight_cache = NULL;
+	localdecl_free (editor->local_index);
+	editor->local_index = NULL;
+}
+
 CEditor *
 ceditor_new_with_text (const gchar *label, const gchar *code_buf)
 {
 	/* Create a new empty editor, label will be the file name. */
 	CEditor *new_editor;
-	GtkTextIter start, end;
 	GtkTextIter startitr, enditr;
 	gint start_line, end_line;
 	GtkTextTagTable *tag_table;
@@ -232,12 +259,19 @@ ceditor_new_with_text (const gchar *label, const gchar *code_buf)
 	gtk_text_buffer_get_end_iter (buffer, &enditr);
 	start_line = gtk_text_iter_get_line (&startitr);
 	end_line = gtk_text_iter_get_line (&enditr);
+
+	if (ceditor_is_large (strlen (code_buf), end_line - start_line + 1)) {
+		ceditor_set_large_file (new_editor);
+	}
 	
 	ceditor_append_line_label (new_editor, end_line - start_line + 1);
 	
-	gtk_text_buffer_get_start_iter (buffer, &start);
-	gtk_text_buffer_get_end_iter (buffer, &end);
-	highlight_apply (buffer, &start, &end);
+	if (new_editor->highlight_cache != NULL) {
+		highlight_cache_insert_lines (new_editor->highlight_cache, start_line, end_line - start_line);
+		if (!highlight_cache_load (new_editor->highlight_cache, label, code_buf)) {
+			highlight_update (new_editor->highlight_cache);
+		}
+	}
 	
 	ceditor_set_tabs (new_editor->textview);
 	ceditor_line_label_set_font (new_editor);
@@ -245,6 +279,133 @@ ceditor_new_with_text (const gchar *label, const gchar *code_buf)
 	return new_editor;
 }
 
+static void
+ceditor_load_free (CEditor *editor)
+{
+	CEditorLoad *load;
+
+	load = editor->load;
+	if (load->id != 0) {
+		g_source_remove (load->id);
+	}
+	fclose (load->file);
+	gtk_widget_destroy (load->progress);
+	g_free ((gpointer) load->chunk);
+	g_free ((gpointer) load);
+
+	editor->load = NULL;
+}
+
+static gboolean
+ceditor_load_chunk (gpointer data)
+{
+	/* Append the next chunk of the file being loaded to the buffer, the
+	 * main loop gets to run between two chunks.
+	 */
+	CEditor *editor;
+	CEditorLoad *load;
+	GtkTextBuffer *buffer;
+	GtkTextIter iter;
+	const gchar *valid_end;
+	gsize len;
+	gsize valid;
+	gboolean eof;
+
+	editor = (CEditor *) data;
+	load = editor->load;
+	buffer = gtk_text_view_get_buffer (GTK_TEXT_VIEW (editor->textview));
+
+	len = fread (load->chunk + load->pending, 1, EDITOR_LOAD_CHUNK - load->pending, load->file);
+	load->done += len;
+	len += load->pending;
+	eof = feof (load->file) || ferror (load->file);
+
+	/* Invalid bytes become '?', a character cut by the end of the chunk
+	 * is kept for the next one.
+	 */
+	valid = 0;
+	load->pending = 0;
+	while (!g_utf8_validate (load->chunk + valid, len - valid, &valid_end)) {
+		valid = valid_end - load->chunk;
+		if (!eof && len - valid < 4) {
+			load->pending = len - valid;
+			break;
+		}
+		load->chunk[valid] = '?';
+	}
+	valid = len - load->pending;
+
+	/* Loading is not an edit. */
+	g_signal_handlers_block_by_func (buffer, on_editor_insert, NULL);
+	g_signal_handlers_block_by_func (buffer, on_textbuffer_changed, NULL);
+	gtk_text_buffer_get_end_iter (buffer, &iter);
+	gtk_text_buffer_insert (buffer, &iter, load->chunk, valid);
+	g_signal_handlers_unblock_by_func (buffer, on_textbuffer_changed, NULL);
+	g_signal_handlers_unblock_by_func (buffer, on_editor_insert, NULL);
+
+	memmove (load->chunk, load->chunk + valid, load->pending);
+
+	if (!eof) {
+		gtk_progress_bar_set_fraction (GTK_PROGRESS_BAR (load->progress),
+									   load->size > 0? MIN (1.0, (gdouble) load->done / load->size): 0.0);
+
+		return TRUE;
+	}
+
+	load->id = 0;
+	ceditor_load_free (editor);
+
+	editor->linecount = gtk_text_buffer_get_line_count (buffer);
+	gtk_text_buffer_get_start_iter (buffer, &iter);
+	gtk_text_buffer_place_cursor (buffer, &iter);
+	gtk_text_view_set_editable (GTK_TEXT_VIEW (editor->textview), TRUE);
+
+	return FALSE;
+}
+
+/* Create an editor for a file too large to be read and inserted at once.
+ * It is streamed into the buffer in chunks from idle calls, with a progress
+ * bar in the tab label, and edited in large file mode afterwards.
+ */
+CEditor *
+ceditor_new_with_file (const gchar *filepath)
+{
+	CEditor *new_editor;
+	CEditorLoad *load;
+	GStatBuf stat_buf;
+	FILE *file;
+
+	file = g_fopen (filepath, "rb");
+	if (file == NULL) {
+		g_warning ("failed to open file %s.", filepath);
+
+		return NULL;
+	}
+
+	new_editor = (CEditor *) g_malloc0 (sizeof (CEditor));
+	new_editor->textview = gtk_text_view_new ();
+	ceditor_init (new_editor, filepath);
+	ceditor_set_large_file (new_editor);
+	ceditor_append_line_label (new_editor, 1);
+	gtk_text_view_set_editable (GTK_TEXT_VIEW (new_editor->textview), FALSE);
+
+	load = (CEditorLoad *) g_malloc0 (sizeof (CEditorLoad));
+	load->file = file;
+	load->size = g_stat (filepath, &stat_buf) == 0? stat_buf.st_size: 0;
+	load->chunk = (gchar *) g_malloc (EDITOR_LOAD_CHUNK);
+	load->progress = gtk_progress_bar_new ();
+	gtk_widget_set_size_request (load->progress, 40, -1);
+	gtk_widget_set_valign (load->progress, GTK_ALIGN_CENTER);
+	gtk_box_pack_end (GTK_BOX (new_editor->label_box), load->progress, 0, 0, 0);
+	new_editor->load = load;
+	load->id = g_idle_add (ceditor_load_chunk, (gpointer) new_editor);
+
+	ceditor_set_tabs (new_editor->textview);
+	ceditor_line_label_set_font (new_editor);
+
+	return new_editor;
+}
+
 void
 ceditor_remove (CEditor *editor)
 {
@@ -274,7 +435,18 @@ ceditor_remove (CEditor *editor)
 	}
 	g_list_free (editor->breakpoint_list);
 
+	if (editor->load != NULL) {
+		ceditor_load_free (editor);
+	}
+	if (editor->autoindent_id != 0) {
+		g_source_remove (editor->autoindent_id);
+	}
+
+	localdecl_free (editor->local_index);
 	gtk_widget_destroy (editor->scroll);
+	if (editor->highlight_cache != NULL) {
+		highlight_cache_free (editor->highlight_cache);
+	}
 	g_free (editor->filepath);
 	g_free (editor);
 }
@@ -359,7 +531,12 @@ ceditor_show (CEditor *editor)
 	gtk_widget_show (editor->label_name);
 	gtk_widget_show (editor->close_button);
 	gtk_widget_show (editor->scroll);
-	gtk_widget_show (editor->event_scroll);
+	if (!editor->large_file) {
+		gtk_widget_show (editor->event_scroll);
+	}
+	if (editor->load != NULL) {
+		gtk_widget_show (editor->load->progress);
+	}
 	gtk_widget_show (editor->textview);
 	gtk_widget_show (editor->lineno);
 	gtk_widget_show (editor->linebox);
@@ -396,38 +573,38 @@ void
 ceditor_append_line_label (CEditor *editor, gint lines)
 {
 	/* Update line number column. */
-	gchar *text;
+	GString *text;
 	gint i;
-	gint len;
-	gint label_len;
-	gint extra_len = lines * (MAX_LINE_NUMBER_LENGTH + 1);
+
+	/* Large files have no line number column. */
+	if (editor->large_file) {
+		editor->linecount += lines;
+
+		return;
+	}
 	
-	label_len = strlen (gtk_label_get_text (GTK_LABEL (editor->lineno))) + extra_len + 1;
-	text = g_malloc (sizeof (gchar) * label_len);
-	g_strlcpy (text, gtk_label_get_text (GTK_LABEL (editor->lineno)), label_len);
+	text = g_string_sized_new (strlen (gtk_label_get_text (GTK_LABEL (editor->lineno))) +
+							   lines * (MAX_LINE_NUMBER_LENGTH + 1) + 1);
+	g_string_append (text, gtk_label_get_text (GTK_LABEL (editor->lineno)));
 	
 	if (editor->linecount != 0) {
-		g_strlcat (text, "\n", label_len);
+		g_string_append_c (text, '\n');
 	}
 	for (i = 1; i <= lines; i++)
 	{
-		gchar line[MAX_LINE_NUMBER_LENGTH + 1];
-		
-		g_snprintf (line, MAX_LINE_NUMBER_LENGTH, "%d\n", i + editor->linecount);
-		g_strlcat (text, line, label_len);
+		g_string_append_printf (text, "%d\n", i + editor->linecount);
 	}
-	len = strlen (text);
 
 	/* Update linecount. */
 	editor->linecount += lines;
 
-	if (text[len - 1] == '\n') {
-		text[len - 1] = 0;
+	if (text->len > 0 && text->str[text->len - 1] == '\n') {
+		g_string_truncate (text, text->len - 1);
 	}
 	
-	gtk_label_set_text (GTK_LABEL (editor->lineno), text);
+	gtk_label_set_text (GTK_LABEL (editor->lineno), text->str);
 
-	g_free ((gpointer) text);
+	g_string_free (text, TRUE);
 }
 
 void
@@ -442,6 +619,12 @@ ceditor_remove_line_label (CEditor *editor, gint lines)
 	if (lines <= 0) {
 		return;
 	}
+
+	if (editor->large_file) {
+		editor->linecount -= lines;
+
+		return;
+	}
 	
 	text = (gchar *) g_malloc (MAX_LINE_BUFFER_SIZE + 1);
 	g_strlcpy (text, gtk_label_get_text (GTK_LABEL (editor->lineno)), MAX_LINE_BUFFER_SIZE);
@@ -909,12 +1092,91 @@ ceditor_move_corsor (CEditor *editor, const gint offset)
 						   0, FALSE, NULL);
 }
 
+/* Copy the identifier around the cursor to word, empty if there is none. */
+void
+ceditor_word_at_cursor (CEditor *editor, gchar *word, const gint size)
+{
+	GtkTextBuffer *buffer;
+	GtkTextIter start, end;
+	gchar *text;
+
+	buffer = gtk_text_view_get_buffer (GTK_TEXT_VIEW (editor->textview));
+	gtk_text_buffer_get_iter_at_mark (buffer, &start, gtk_text_buffer_get_insert (buffer));
+	end = start;
+
+	while (!gtk_text_iter_is_start (&start)) {
+		gunichar ch;
+
+		gtk_text_iter_backward_char (&start);
+		ch = gtk_text_iter_get_char (&start);
+		if (!g_unichar_isalnum (ch) && ch != '_') {
+			gtk_text_iter_forward_char (&start);
+			break;
+		}
+	}
+	while (!gtk_text_iter_is_end (&end)) {
+		gunichar ch;
+
+		ch = gtk_text_iter_get_char (&end);
+		if (!g_unichar_isalnum (ch) && ch != '_') {
+			break;
+		}
+		gtk_text_iter_forward_char (&end);
+	}
+
+	text = gtk_text_buffer_get_text (buffer, &start, &end, FALSE);
+	g_strlcpy (word, text, size);
+	g_free ((gpointer) text);
+}
+
+/* Put the cursor at the start of line, counted from 1, and scroll to it. */
+void
+ceditor_goto_line (CEditor *editor, const gint line)
+{
+	GtkTextBuffer *buffer;
+	GtkTextIter iter;
+
+	buffer = gtk_text_view_get_buffer (GTK_TEXT_VIEW (editor->textview));
+	gtk_text_buffer_get_iter_at_line (buffer, &iter, MAX (line - 1, 0));
+	gtk_text_buffer_place_cursor (buffer, &iter);
+	gtk_text_view_scroll_to_mark (GTK_TEXT_VIEW (editor->textview),
+								  gtk_text_buffer_get_insert (buffer),
+								  0.0, TRUE, 0.0, 0.3);
+}
+
 gboolean
 ceditor_get_need_highlight(CEditor *editor)
 {
 	return editor->need_highlight;
 }
 
+static gboolean
+ceditor_autoindent_idle (gpointer data)
+{
+	CEditor *editor;
+	GtkTextBuffer *buffer;
+
+	editor = (CEditor *) data;
+	editor->autoindent_id = 0;
+
+	buffer = gtk_text_view_get_buffer (GTK_TEXT_VIEW (editor->textview));
+	if (editor->autoindent_line < gtk_text_buffer_get_line_count (buffer)) {
+		autoindent_apply (buffer, NULL, editor->autoindent_line, editor->autoindent_line);
+	}
+
+	return FALSE;
+}
+
+/* Indent line once the main loop is idle instead of while handling a key. */
+void
+ceditor_autoindent_later (CEditor *editor, const gint line)
+{
+	editor->autoindent_line = line;
+	if (editor->autoindent_id == 0) {
+		editor->autoindent_id = g_idle_add (ceditor_autoindent_idle, (gpointer) editor);
+	}
+}
+
 void
 ceditor_set_need_highlight(CEditor *editor, gboolean need)
 {
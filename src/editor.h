@@ -21,9 +21,12 @@
 #ifndef EDITOR_H
 #define EDITOR_H
 
+#include <stdio.h>
 #include <gtk/gtk.h>
 
 #include "edithistory.h"
+#include "highlighting.h"
+#include "localdecl.h"
 
 /* GTK stocks. */
 #define CODEFOX_STOCK_CLOSE "window-close" 
@@ -52,6 +55,17 @@ typedef struct {
 	gint line;
 } CBreakPointNode;
 
+/* A file being streamed into the buffer of an editor in large file mode. */
+typedef struct {
+	FILE *file;
+	gint64 size;
+	gint64 done;
+	gchar *chunk;
+	gsize pending;
+	GtkWidget *progress;
+	guint id;
+} CEditorLoad;
+
 typedef struct {
 	GtkWidget *label_box;
 	GtkWidget *label_name;
@@ -74,6 +88,12 @@ typedef struct {
 	gint total_matched;
 	gint next_modify_omit;
 	gboolean need_highlight;
+	CHighlightCache *highlight_cache;
+	CLocalIndex *local_index;
+	gboolean large_file;
+	CEditorLoad *load;
+	gint autoindent_line;
+	guint autoindent_id;
 } CEditor;
 
 CEditor *
@@ -82,6 +102,9 @@ ceditor_new (const gchar *label);
 CEditor *
 ceditor_new_with_text (const gchar *label, const gchar *code_buf);
 
+CEditor *
+ceditor_new_with_file (const gchar *filepath);
+
 void
 ceditor_remove (CEditor *editor);
 
@@ -179,9 +202,18 @@ ceditor_select_range (CEditor *editor, const gint offset, const gint len);
 void
 ceditor_move_corsor (CEditor *editor, const gint offset);
 
+void
+ceditor_goto_line (CEditor *editor, const gint line);
+
+void
+ceditor_word_at_cursor (CEditor *editor, gchar *word, const gint size);
+
 gboolean
 ceditor_get_need_highlight(CEditor *editor);
 
+void
+ceditor_autoindent_later (CEditor *editor, const gint line);
+
 void
 ceditor_set_need_highlight(CEditor *editor, gboolean need);
 
@@ -27,6 +27,10 @@
 #define DEFAULT_COMMENT_COLOR "#888376"
 #define DEFAULT_PREPROCESSOR_COLOR "#BF4040"
 
+#define DEFAULT_LARGE_FILE_SIZE (8 << 20)
+#define DEFAULT_LARGE_FILE_LINES 100000
+#define DEFAULT_STATIC_CHECK_DELAY 300
+
 static CEditorConfig *default_config;
 static CEditorConfig *user_config;
 
@@ -34,12 +38,35 @@ void
 editorconfig_default_config_new ()
 {
 	CCodeColorStyle *color_style;
+	const gchar *env;
 	gboolean ret;
 
 	default_config = (CEditorConfig *) g_malloc (sizeof (CEditorConfig));
 	default_config->code_color = (CCodeColorStyle *) g_malloc0 (sizeof (CCodeColorStyle));
 
 	default_config->pfd = pango_font_description_from_string ("monospace 10");
+	default_config->large_file_size = DEFAULT_LARGE_FILE_SIZE;
+	default_config->large_file_lines = DEFAULT_LARGE_FILE_LINES;
+	default_config->static_check_delay = DEFAULT_STATIC_CHECK_DELAY;
+	default_config->span_cache_size = 0;
+
+	/* Large file thresholds may be set from the environment. */
+	env = g_getenv ("CODEFOX_LARGE_FILE_SIZE");
+	if (env != NULL && g_ascii_strtoll (env, NULL, 10) > 0) {
+		default_config->large_file_size = g_ascii_strtoll (env, NULL, 10);
+	}
+	env = g_getenv ("CODEFOX_LARGE_FILE_LINES");
+	if (env != NULL && g_ascii_strtoll (env, NULL, 10) > 0) {
+		default_config->large_file_lines = (gint) g_ascii_strtoll (env, NULL, 10);
+	}
+	env = g_getenv ("CODEFOX_STATIC_CHECK_DELAY");
+	if (env != NULL && g_ascii_strtoll (env, NULL, 10) > 0) {
+		default_config->static_check_delay = (gint) g_ascii_strtoll (env, NULL, 10);
+	}
+	env = g_getenv ("CODEFOX_SPAN_CACHE_SIZE");
+	if (env != NULL && g_ascii_strtoll (env, NULL, 10) > 0) {
+		default_config->span_cache_size = g_ascii_strtoll (env, NULL, 10);
+	}
 
 	color_style = default_config->code_color;
 
@@ -84,6 +111,10 @@ editorconfig_user_config_from_default ()
 		user_config = (CEditorConfig *) g_malloc (sizeof (CEditorConfig));
 		user_config->pfd = default_config->pfd;
 		user_config->code_color = default_config->code_color;
+		user_config->large_file_size = default_config->large_file_size;
+		user_config->large_file_lines = default_config->large_file_lines;
+		user_config->static_check_delay = default_config->static_check_delay;
+		user_config->span_cache_size = default_config->span_cache_size;
 	}
 }
 
@@ -32,9 +32,19 @@ typedef struct {
 	GdkRGBA preprocessor_color;
 } CCodeColorStyle;
 
+/* Files over large_file_size bytes or large_file_lines lines are opened
+ * in large file mode, see ceditor_new_with_file (). The static check runs
+ * static_check_delay milliseconds after the last edit. Highlighting spans
+ * are kept on disk across sessions only if span_cache_size, the bytes the
+ * per user cache may take, is above 0.
+ */
 typedef struct {
 	PangoFontDescription *pfd;
 	CCodeColorStyle *code_color;
+	gint64 large_file_size;
+	gint large_file_lines;
+	gint static_check_delay;
+	gint64 span_cache_size;
 } CEditorConfig;
 
 void
@@ -79,6 +79,7 @@ env_init()
 	env_extern_prog[ENV_PROG_GCC] = env_check_external_prog ("gcc");
 	env_extern_prog[ENV_PROG_GPP] = env_check_external_prog ("g++");
 	env_extern_prog[ENV_PROG_MAKE] = env_check_external_prog ("make");
+	env_extern_prog[ENV_PROG_PKG_CONFIG] = env_check_external_prog ("pkg-config");
 }
 
 gboolean
@@ -31,7 +31,8 @@
 #define ENV_PROG_CSCOPE 5
 #define ENV_PROG_GCC 6
 #define ENV_PROG_GPP 7
-#define ENV_PROG_MAKE 8	
+#define ENV_PROG_MAKE 8
+#define ENV_PROG_PKG_CONFIG 9
 
 void
 env_init();
@@ -0,0 +1,428 @@
+/*
+ * highlightbench.c
+ * This file is part of codefox
+ *
+ * Copyright (C) 2012-2017 - Gordon Li
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/* Benchmark of the highlighter without the editor window. Run it as
+ * "highlightbench [-o JSON] [-r REVISION] [PATH]", PATH being a C/C++
+ * source or a directory searched for them, a generated 10 MB source is
+ * used without PATH. Each file is lexed on its own, has its keywords
+ * looked up, and is highlighted in a GtkTextBuffer no view shows, once
+ * from scratch and once again over its own tags. Results go to JSON or
+ * else to stdout as JSON.
+ */
+
+#include <stdio.h>
+#include <string.h>
+#include <sys/resource.h>
+
+#include <gtk/gtk.h>
+
+#include "highlighting.h"
+#include "keywords.h"
+#include "charclass.h"
+#include "editorconfig.h"
+
+#define BENCH_ROUNDS 5
+
+#define BENCH_GENERATED_SIZE (10 * 1024 * 1024)
+
+/* Time in microseconds, count of what is measured and another figure. */
+typedef struct {
+	gint64 time;
+	gint64 count;
+	gint64 extra;
+} CBenchResult;
+
+static const gchar *bench_extensions[] = {".c", ".h", ".cc", ".cpp", ".cxx", ".hh", ".hpp", ".hxx", NULL};
+
+static gchar *
+bench_generate (gsize *len)
+{
+	GString *code;
+	gint i;
+
+	code = g_string_new (NULL);
+	for (i = 0; code->len < BENCH_GENERATED_SIZE; i++) {
+		g_string_append_printf (code,
+								"/* Function number %d, with a comment that\n"
+								" * goes over two lines. */\n"
+								"#define VALUE_%d %d\n"
+								"static int\n"
+								"function_%d (const char *name, unsigned long value)\n"
+								"{\n"
+								"\tint result = value * VALUE_%d + 0x%x;\n\n"
+								"\tif (name != NULL && name[0] == '\\'') {\n"
+								"\t\tprintf (\"%%s: \\\"%%d\\\"\\n\", name, result); // trace\n"
+								"\t}\n"
+								"\telse while (result > 0) {\n"
+								"\t\tresult -= sizeof (struct timeval);\n"
+								"\t}\n\n"
+								"\treturn result;\n"
+								"}\n\n", i, i, i, i, i, i);
+	}
+
+	*len = code->len;
+
+	return g_string_free (code, FALSE);
+}
+
+static gboolean
+bench_is_source (const gchar *name)
+{
+	gint i;
+
+	for (i = 0; bench_extensions[i] != NULL; i++) {
+		if (g_str_has_suffix (name, bench_extensions[i])) {
+			return TRUE;
+		}
+	}
+
+	return FALSE;
+}
+
+static void
+bench_load (const gchar *path, GPtrArray *files, gsize *bytes)
+{
+	/* Collect the sources at path, directories are searched recursively. */
+	GDir *dir;
+	const gchar *name;
+	gchar *text;
+	gsize len;
+
+	if (!g_file_test (path, G_FILE_TEST_IS_DIR)) {
+		if (!g_file_get_contents (path, &text, &len, NULL)) {
+			fprintf (stderr, "can't read %s.\n", path);
+
+			return;
+		}
+
+		/* Text buffers only take UTF-8. */
+		if (!g_utf8_validate (text, len, NULL)) {
+			fprintf (stderr, "%s is not UTF-8, skipped.\n", path);
+			g_free ((gpointer) text);
+
+			return;
+		}
+
+		g_ptr_array_add (files, (gpointer) text);
+		*bytes += len;
+
+		return;
+	}
+
+	dir = g_dir_open (path, 0, NULL);
+	if (dir == NULL) {
+		fprintf (stderr, "can't open %s.\n", path);
+
+		return;
+	}
+
+	while ((name = g_dir_read_name (dir)) != NULL) {
+		gchar *child;
+
+		child = g_build_filename (path, name, NULL);
+		if (g_file_test (child, G_FILE_TEST_IS_DIR) || bench_is_source (name)) {
+			bench_load (child, files, bytes);
+		}
+		g_free ((gpointer) child);
+	}
+
+	g_dir_close (dir);
+}
+
+static CBenchResult
+bench_lex (GPtrArray *files)
+{
+	/* Best of BENCH_ROUNDS, tokens are the spans found. */
+	CBenchResult best;
+	gint round;
+
+	memset (&best, 0, sizeof (CBenchResult));
+	best.time = G_MAXINT64;
+	for (round = 0; round < BENCH_ROUNDS; round++) {
+		GArray *spans;
+		gint64 start;
+		gint64 count;
+		gint64 lines;
+		guint i;
+
+		spans = g_array_new (FALSE, FALSE, sizeof (CHighlightSpan));
+		count = 0;
+		lines = 0;
+		start = g_get_monotonic_time ();
+		for (i = 0; i < files->len; i++) {
+			g_array_set_size (spans, 0);
+			lines += highlight_lex_text ((const gchar *) g_ptr_array_index (files, i), spans,
+										 KEYWORDS_C | KEYWORDS_CPP);
+			count += spans->len;
+		}
+		best.time = MIN (best.time, g_get_monotonic_time () - start);
+		best.count = count;
+		best.extra = lines;
+
+		g_array_free (spans, TRUE);
+	}
+
+	return best;
+}
+
+static CBenchResult
+bench_keywords (GPtrArray *files)
+{
+	/* Lookups of every word of the sources, words are found beforehand. */
+	CBenchResult best;
+	GArray *words;
+	gint round;
+	guint i;
+
+	words = g_array_new (FALSE, FALSE, sizeof (const gchar *));
+	for (i = 0; i < files->len; i++) {
+		const gchar *p, *end;
+
+		p = (const gchar *) g_ptr_array_index (files, i);
+		end = p + strlen (p);
+		while (p < end) {
+			const gchar *word_end;
+
+			word_end = charclass_skip_ident (p, end);
+			if (word_end > p) {
+				g_array_append_val (words, p);
+				g_array_append_val (words, word_end);
+				p = word_end;
+			}
+			else {
+				p++;
+			}
+		}
+	}
+
+	memset (&best, 0, sizeof (CBenchResult));
+	best.time = G_MAXINT64;
+	best.count = words->len / 2;
+	for (round = 0; round < BENCH_ROUNDS; round++) {
+		gint64 start;
+		gint64 hits;
+
+		hits = 0;
+		start = g_get_monotonic_time ();
+		for (i = 0; i < words->len; i += 2) {
+			const gchar *word, *word_end;
+
+			word = g_array_index (words, const gchar *, i);
+			word_end = g_array_index (words, const gchar *, i + 1);
+			hits += keywords_is_keyword (word, word_end - word, KEYWORDS_C | KEYWORDS_CPP);
+		}
+		best.time = MIN (best.time, g_get_monotonic_time () - start);
+		best.extra = hits;
+	}
+
+	g_array_free (words, TRUE);
+
+	return best;
+}
+
+static void
+bench_on_apply_tag (GtkTextBuffer *buffer, GtkTextTag *tag, GtkTextIter *start,
+					GtkTextIter *end, gpointer data)
+{
+	((CBenchResult *) data)->count++;
+}
+
+static void
+bench_on_remove_tag (GtkTextBuffer *buffer, GtkTextTag *tag, GtkTextIter *start,
+					 GtkTextIter *end, gpointer data)
+{
+	((CBenchResult *) data)->extra++;
+}
+
+static void
+bench_highlight_wait (CHighlightCache *cache)
+{
+	/* Run the main loop until the lexer and all idle slices are done. */
+	highlight_update (cache);
+	while (cache->dirty_start != -1 || cache->lexing) {
+		g_main_context_iteration (NULL, TRUE);
+	}
+}
+
+static void
+bench_buffer (GPtrArray *files, CBenchResult *first, CBenchResult *again)
+{
+	/* Highlight every file in a new buffer, then all of it once more. */
+	guint i;
+
+	memset (first, 0, sizeof (CBenchResult));
+	memset (again, 0, sizeof (CBenchResult));
+	for (i = 0; i < files->len; i++) {
+		GtkTextBuffer *buffer;
+		CHighlightCache *cache;
+		const gchar *text;
+		gint lines;
+		gint64 start;
+
+		text = (const gchar *) g_ptr_array_index (files, i);
+		buffer = gtk_text_buffer_new (NULL);
+		highlight_register (buffer);
+		cache = highlight_cache_new_with_buffer (buffer);
+		gtk_text_buffer_set_text (buffer, text, -1);
+		lines = gtk_text_buffer_get_line_count (buffer);
+
+		g_signal_connect (buffer, "apply-tag", G_CALLBACK (bench_on_apply_tag), first);
+		g_signal_connect (buffer, "remove-tag", G_CALLBACK (bench_on_remove_tag), first);
+		start = g_get_monotonic_time ();
+		highlight_cache_insert_lines (cache, 0, lines - 1);
+		bench_highlight_wait (cache);
+		first->time += g_get_monotonic_time () - start;
+		g_signal_handlers_disconnect_by_data (buffer, first);
+
+		g_signal_connect (buffer, "apply-tag", G_CALLBACK (bench_on_apply_tag), again);
+		g_signal_connect (buffer, "remove-tag", G_CALLBACK (bench_on_remove_tag), again);
+		start = g_get_monotonic_time ();
+		highlight_cache_invalidate (cache, 0, lines - 1);
+		bench_highlight_wait (cache);
+		again->time += g_get_monotonic_time () - start;
+		g_signal_handlers_disconnect_by_data (buffer, again);
+
+		highlight_cache_free (cache);
+		g_object_unref (buffer);
+	}
+}
+
+static gdouble
+bench_rate (const gdouble count, const gint64 time)
+{
+	return count * G_USEC_PER_SEC / MAX (time, 1);
+}
+
+static void
+bench_print (FILE *out, const gchar *name, const CBenchResult *result, const gsize bytes,
+			 const gchar *count_name, const gchar *extra_name)
+{
+	fprintf (out, "  \"%s\": {\"seconds\": %.6f, \"mb_per_s\": %.3f, \"%s\": %" G_GINT64_FORMAT
+			 ", \"%s_per_s\": %.1f, \"%s\": %" G_GINT64_FORMAT "},\n",
+			 name, (gdouble) result->time / G_USEC_PER_SEC,
+			 bench_rate (bytes / (1024.0 * 1024.0), result->time),
+			 count_name, result->count, count_name, bench_rate (result->count, result->time),
+			 extra_name, result->extra);
+}
+
+static void
+bench_print_string (FILE *out, const gchar *name, const gchar *value)
+{
+	/* A JSON string member, escaping what JSON requires. */
+	fprintf (out, "\"%s\": \"", name);
+	for (; *value; value++) {
+		if (*value == '\"' || *value == '\\') {
+			fprintf (out, "\\%c", *value);
+		}
+		else if ((guchar) *value < 0x20) {
+			fprintf (out, "\\u%04x", (guchar) *value);
+		}
+		else {
+			fputc (*value, out);
+		}
+	}
+	fputc ('\"', out);
+}
+
+int
+main (int argc, char *argv[])
+{
+	GPtrArray *files;
+	CBenchResult lex, keywords, first, again;
+	struct rusage usage;
+	const gchar *output;
+	const gchar *revision;
+	const gchar *path;
+	gsize bytes;
+	FILE *out;
+	gint i;
+
+	output = NULL;
+	revision = "";
+	path = NULL;
+	for (i = 1; i < argc; i++) {
+		if (g_strcmp0 (argv[i], "-o") == 0 && i + 1 < argc) {
+			output = argv[++i];
+		}
+		else if (g_strcmp0 (argv[i], "-r") == 0 && i + 1 < argc) {
+			revision = argv[++i];
+		}
+		else {
+			path = argv[i];
+		}
+	}
+
+	/* Text buffers work without a display, nothing is shown. */
+	gtk_init_check (&argc, &argv);
+	editorconfig_default_config_new ();
+	editorconfig_user_config_from_default ();
+	highlight_init ();
+
+	files = g_ptr_array_new_with_free_func (g_free);
+	bytes = 0;
+	if (path != NULL) {
+		bench_load (path, files, &bytes);
+	}
+	else {
+		gsize len;
+
+		g_ptr_array_add (files, (gpointer) bench_generate (&len));
+		bytes = len;
+	}
+
+	if (files->len == 0) {
+		fprintf (stderr, "no sources to highlight.\n");
+
+		return 1;
+	}
+
+	lex = bench_lex (files);
+	keywords = bench_keywords (files);
+	bench_buffer (files, &first, &again);
+
+	getrusage (RUSAGE_SELF, &usage);
+
+	out = output != NULL? fopen (output, "w"): stdout;
+	if (out == NULL) {
+		fprintf (stderr, "can't write %s.\n", output);
+
+		return 1;
+	}
+
+	fprintf (out, "{\n  ");
+	bench_print_string (out, "revision", revision);
+	fprintf (out, ",\n  \"corpus\": {");
+	bench_print_string (out, "path", path != NULL? path: "generated");
+	fprintf (out, ", \"files\": %u, \"bytes\": %" G_GSIZE_FORMAT "},\n", files->len, bytes);
+	bench_print (out, "lexer", &lex, bytes, "tokens", "lines");
+	bench_print (out, "keywords", &keywords, bytes, "lookups", "keywords");
+	bench_print (out, "buffer", &first, bytes, "tag_applications", "tag_removals");
+	bench_print (out, "rehighlight", &again, bytes, "tag_applications", "tag_removals");
+	fprintf (out, "  \"peak_rss_kb\": %ld\n", usage.ru_maxrss);
+	fprintf (out, "}\n");
+
+	if (out != stdout) {
+		fclose (out);
+	}
+
+	g_ptr_array_free (files, TRUE);
+
+	return 0;
+}
@@ -18,20 +18,200 @@
  * along with this program.  If not, see <http://www.gnu.org/licenses/>.
  */
 
+#include <string.h>
+
 #include <gtk/gtk.h>
 #include "highlighting.h"
 #include "keywords.h"
+#include "charclass.h"
+#include "spancache.h"
 #include "editorconfig.h"
+#include "project.h"
 #include "ui.h"
 
-#define MAX_LEX_SIZE 1000000
+/* Lines lexed past the edited ones while waiting for line states to converge. */
+#define HIGHLIGHT_LOOKAHEAD_LINES 2000
+
+/* Spans retagged together, between two checks of the time budget. */
+#define HIGHLIGHT_SLICE_SPANS 256
+
+/* Time budget of one idle slice of tag application, in microseconds. */
+#define HIGHLIGHT_SLICE_TIME 4000
 
-static gchar lex[MAX_LEX_SIZE + 1];
+/* Lines above and below the visible ones that are highlighted first. */
+#define HIGHLIGHT_VIEW_MARGIN 50
+
+typedef struct {
+	CHighlightCache *cache;
+	gchar *text;
+	gint state;
+	gint dirty_lines;
+	gboolean to_end;
+	guint revision;
+	guint8 *old_states;
+	gint old_len;
+	GArray *states;
+	GArray *spans;
+	gint lexed_lines;
+	gint chars;
+	gboolean converged;
+	gint dialects;
+} CHighlightJob;
+
+static const gchar *highlight_tags[HIGHLIGHT_TAG_COUNT] = {
+	CODE_TAG_NONE,
+	CODE_TAG_PREPROCESSOR,
+	CODE_TAG_KEYWORD,
+	CODE_TAG_CONSTANT,
+	CODE_TAG_STRING,
+	CODE_TAG_COMMENT
+};
 
 void
 highlight_init ()
 {
-	keywords_init ();
+	charclass_init ();
+	spancache_init ();
+}
+
+/* Cache of a buffer no view shows, its first lines are highlighted first. */
+CHighlightCache *
+highlight_cache_new_with_buffer (GtkTextBuffer *buffer)
+{
+	/* Tags of buffer must have been registered already. */
+	CHighlightCache *cache;
+	GtkTextTagTable *tag_table;
+	guint8 state = HIGHLIGHT_STATE_CODE;
+	gint i;
+
+	cache = (CHighlightCache *) g_malloc0 (sizeof (CHighlightCache));
+	cache->buffer = buffer;
+	tag_table = gtk_text_buffer_get_tag_table (cache->buffer);
+	for (i = 0; i < HIGHLIGHT_TAG_COUNT; i++) {
+		cache->tags[i] = gtk_text_tag_table_lookup (tag_table, highlight_tags[i]);
+	}
+	cache->line_states = g_array_new (FALSE, TRUE, sizeof (guint8));
+	g_array_append_val (cache->line_states, state);
+	cache->dirty_start = -1;
+	cache->dirty_end = -1;
+
+	return cache;
+}
+
+CHighlightCache *
+highlight_cache_new (GtkTextView *view)
+{
+	CHighlightCache *cache;
+
+	cache = highlight_cache_new_with_buffer (gtk_text_view_get_buffer (view));
+	cache->view = view;
+
+	return cache;
+}
+
+static void
+highlight_cache_cancel_apply (CHighlightCache *cache)
+{
+	if (cache->apply_id != 0) {
+		g_source_remove (cache->apply_id);
+		cache->apply_id = 0;
+	}
+	if (cache->spans != NULL) {
+		g_array_free (cache->spans, TRUE);
+		g_free ((gpointer) cache->batches);
+		cache->spans = NULL;
+		cache->batches = NULL;
+	}
+}
+
+/* An edit stops the apply halfway. The states of the lexed lines are
+ * committed already, so a re-lex of just the edited lines would stop at
+ * them and leave the rest with the tags they had before; keep all of
+ * them dirty.
+ */
+static void
+highlight_cache_drop_apply (CHighlightCache *cache)
+{
+	if (cache->dirty_start == -1 || cache->apply_line < cache->dirty_start) {
+		cache->dirty_start = cache->apply_line;
+	}
+	cache->dirty_end = MAX (cache->dirty_end, cache->apply_end_line);
+
+	highlight_cache_cancel_apply (cache);
+}
+
+static void
+highlight_cache_destroy (CHighlightCache *cache)
+{
+	highlight_cache_cancel_apply (cache);
+	g_array_free (cache->line_states, TRUE);
+	g_free ((gpointer) cache->store_path);
+	g_free (cache);
+}
+
+void
+highlight_cache_free (CHighlightCache *cache)
+{
+	/* A running lexer still refers to cache, let it free cache when done. */
+	if (cache->lexing) {
+		highlight_cache_cancel_apply (cache);
+		cache->freed = TRUE;
+
+		return;
+	}
+
+	highlight_cache_destroy (cache);
+}
+
+void
+highlight_cache_invalidate (CHighlightCache *cache, const gint start_line, const gint end_line)
+{
+	if (cache->dirty_start == -1 || start_line < cache->dirty_start) {
+		cache->dirty_start = start_line;
+	}
+	if (end_line > cache->dirty_end) {
+		cache->dirty_end = end_line;
+	}
+
+	cache->revision++;
+}
+
+/* Lines were inserted after line, their states are unknown until re-lexed. */
+void
+highlight_cache_insert_lines (CHighlightCache *cache, const gint line, const gint lines)
+{
+	guint8 *states;
+
+	if (lines > 0 && line < (gint) cache->line_states->len) {
+		states = (guint8 *) g_malloc0 (lines);
+		g_array_insert_vals (cache->line_states, line + 1, states, lines);
+
+		g_free ((gpointer) states);
+
+		if (cache->dirty_end > line) {
+			cache->dirty_end += lines;
+		}
+	}
+
+	highlight_cache_invalidate (cache, line, line + lines);
+}
+
+/* Lines after line are about to be joined into it. */
+void
+highlight_cache_remove_lines (CHighlightCache *cache, const gint line, const gint lines)
+{
+	gint len;
+
+	len = cache->line_states->len;
+	if (lines > 0 && line + 1 < len) {
+		g_array_remove_range (cache->line_states, line + 1, MIN (lines, len - line - 1));
+
+		if (cache->dirty_end > line) {
+			cache->dirty_end = MAX (line, cache->dirty_end - lines);
+		}
+	}
+
+	highlight_cache_invalidate (cache, line, line);
 }
 
 void 
@@ -53,11 +233,15 @@ highlight_replace (GtkTextBuffer *buffer)
 	tag_replace_tags (buffer, editor_config);
 }
 
-static gboolean
-highlight_is_keyword (gchar *word)
+static gint
+highlight_dialects ()
 {
-	/* Check whether word is a C/C++ keyword. */
-	return keywords_is_keyword (word);
+	/* Outside of a project both keyword sets are highlighted. */
+	if (project_current_path () == NULL) {
+		return KEYWORDS_C | KEYWORDS_CPP;
+	}
+
+	return project_get_type () == PROJECT_C? KEYWORDS_C: KEYWORDS_CPP;
 }
 
 void
@@ -76,32 +260,157 @@ highlight_add_tag (GtkTextBuffer *buffer, GtkTextIter *startitr,
 	gtk_text_buffer_apply_tag_by_name (buffer, tag, &start, &end);
 }
 
-void
-highlight_apply (GtkTextBuffer *buffer, GtkTextIter *start,
-				 GtkTextIter *end)
+static void
+highlight_job_free (CHighlightJob *job)
+{
+	g_free ((gpointer) job->text);
+	g_free ((gpointer) job->old_states);
+	g_array_free (job->states, TRUE);
+	if (job->spans != NULL) {
+		g_array_free (job->spans, TRUE);
+	}
+	g_free ((gpointer) job);
+}
+
+static void
+highlight_span_add (GArray *spans, const gint start, const gint len, const gint tag)
+{
+	CHighlightSpan span;
+
+	span.start = start;
+	span.len = len;
+	span.tag = tag;
+	g_array_append_val (spans, span);
+}
+
+static void
+highlight_spans_to_chars (const gchar *text, GArray *spans, const gint bytes, gint *chars)
+{
+	/* Spans are sorted, so byte offsets convert in a single pass. */
+	const gchar *p;
+	gint offset;
+	guint i;
+
+	p = text;
+	offset = 0;
+	for (i = 0; i < spans->len; i++) {
+		CHighlightSpan *span;
+		gint start;
+
+		span = &g_array_index (spans, CHighlightSpan, i);
+		while (p < text + span->start) {
+			p = g_utf8_next_char (p);
+			offset++;
+		}
+
+		start = offset;
+		while (p < text + span->start + span->len) {
+			p = g_utf8_next_char (p);
+			offset++;
+		}
+
+		span->start = start;
+		span->len = offset - start;
+	}
+
+	while (p < text + bytes) {
+		p = g_utf8_next_char (p);
+		offset++;
+	}
+
+	*chars = offset;
+}
+
+static gboolean highlight_job_done (gpointer data);
+
+/* Lex the text snapshot of job, which begins at a line start in job->state.
+ * The state at the start of each following line goes to job->states, and
+ * lexing stops at the first line after the edited ones whose state is the
+ * same as before, since the rest of the buffer would be lexed the same way.
+ */
+static void
+highlight_lex_job (CHighlightJob *job)
 {
 	/* Use a finite state machine to highlighting a code. */
-	gchar *text;	
+	const gchar *text;
 	gint i;
 	gint lex_len;
-	gint state;
 	gint start_offset;
+	gint state;
+	gint line;
+	gint recorded;
+	gint fast_len;
+	gboolean escape;
+	guint8 line_state;
 	
-	text = gtk_text_iter_get_text (start, end);
+	text = job->text;
+	fast_len = strlen (text) - 1;
+	escape = FALSE;
 	lex_len = 0;
 	start_offset = 0;
-	lex[0] = 0;
-	state = 0;
-
-	gtk_text_buffer_remove_all_tags (buffer, start, end);
-	gtk_text_buffer_apply_tag_by_name (buffer, CODE_TAG_NONE, start, end);
+	state = job->state;
+	line = 0;
+	recorded = 0;
 
 	for (i = 0; text[i]; i++) {		
-		if ((!CHAR (text[i]) && !DIGIT (text[i]) && text[i] > 0) || text[i + 1] == 0) {			
-			gchar *tag;
+		if (i > recorded && text[i - 1] == '\n') {
+			recorded = i;
+			line++;
+
+			/* A star before the line break can't close the comment any more. */
+			line_state = state == 6? 5: state;
+			g_array_append_val (job->states, line_state);
+
+			if (line > job->dirty_lines && line < job->old_len &&
+				line_state == job->old_states[line]) {
+				job->converged = TRUE;
+				break;
+			}
+		}
+
+		/* Skip runs of bytes the state machine would only count. The last
+		 * byte always goes through it, it may end a token.
+		 */
+		if (i < fast_len) {
+			const gchar *p;
+			gint j;
+
+			j = i;
+			if (state == 0) {
+				if (lex_len > 0 || CHARCLASS_IS_IDENT (text[i])) {
+					j = charclass_skip_ident (text + i, text + fast_len) - text;
+					lex_len += j - i;
+				}
+				else {
+					j = charclass_skip_neutral (text + i, text + fast_len) - text;
+				}
+			}
+			else if ((state == 1 || state == 2) && !escape) {
+				j = charclass_find (text + i, text + fast_len,
+									state == 1? '\"': '\'', '\\', '\n') - text;
+				lex_len += j - i;
+			}
+			else if (state == 4) {
+				p = (const gchar *) memchr (text + i, '\n', fast_len - i);
+				j = p != NULL? p - text: fast_len;
+				lex_len += j - i;
+			}
+			else if (state == 5 || state == 6) {
+				/* Only a slash right after a star ends the comment. */
+				j = charclass_find (text + i, text + fast_len, '/', '\n', '\n') - text;
+				if (j > i) {
+					lex_len += j - i;
+					state = text[j - 1] == '*'? 6: 5;
+				}
+			}
+			i = j;
+		}
+
+		if (!CHARCLASS_IS_IDENT (text[i]) || text[i + 1] == 0) {			
+			gint tag;
 			
 			start_offset = i - lex_len;
-			tag = CODE_TAG_NONE;
+			tag = HIGHLIGHT_TAG_NONE;
 
 			switch (state) {
 				case 0:
@@ -110,66 +419,52 @@ highlight_apply (GtkTextBuffer *buffer, GtkTextIter *start,
 					}
 					else if (text[i] == '\"') {
 						state = 1;
-						lex[lex_len++] = text[i];
+						lex_len++;
 					}
 					else if (text[i] == '\'') {
 						state = 2;
-						lex[lex_len++] = text[i];
+						lex_len++;
 					}
 					else if (text[i] == '/') {
 						state = 3;
-						lex[lex_len++] = text[i];
+						lex_len++;
 					}
 					else if (text[i + 1] == 0 && (CHAR (text[i]) || 
 							 DIGIT (text[i]))) {
-						lex[lex_len++] = text[i];
+						lex_len++;
 					}
 					break;
 					
 				case 1:
-					lex[lex_len++] = text[i];
-					if (text[i] == '\"') {
-						gint s = 0;
-						gint j = lex_len - 2;
-						
-						for ( ; j >= 0; j--) {
-							if (lex[j] == '\\') {
-								s++;
-							}
-							else {
-								break;
-							}
-						}
-						if (s % 2 == 0) {
-							state = 0;
-							tag = CODE_TAG_STRING;
-						}
+					lex_len++;
+					if (escape) {
+						escape = FALSE;
+					}
+					else if (text[i] == '\\') {
+						escape = TRUE;
+					}
+					else if (text[i] == '\"') {
+						state = 0;
+						tag = HIGHLIGHT_TAG_STRING;
 					}
 					break;
 					
 				case 2:
-					lex[lex_len++] = text[i];
-					if (text[i] == '\'') {
-						gint s = 0;
-						gint j = lex_len - 2;
-						
-						for ( ; j >= 0; j--) {
-							if (lex[j] == '\\') {
-								s++;
-							}
-							else {
-								break;
-							}
-						}
-						if (s % 2 == 0) {
-							state = 0;
-							tag = CODE_TAG_STRING;
-						}
+					lex_len++;
+					if (escape) {
+						escape = FALSE;
+					}
+					else if (text[i] == '\\') {
+						escape = TRUE;
+					}
+					else if (text[i] == '\'') {
+						state = 0;
+						tag = HIGHLIGHT_TAG_STRING;
 					}
 					break;
 				
 				case 3:
-					lex[lex_len++] = text[i];
+					lex_len++;
 					if (text[i] == '/') {
 						state = 4;
 					}
@@ -180,77 +475,511 @@ highlight_apply (GtkTextBuffer *buffer, GtkTextIter *start,
 						state = 0;
 						i--;
 						lex_len--;
-						tag = CODE_TAG_NONE;
+						tag = HIGHLIGHT_TAG_NONE;
 					}
 					break;
 				
 				case 4:
-					lex[lex_len++] = text[i];
+					lex_len++;
 					if (text[i] == '\n' || text[i + 1] == '\0') {
 						state = 0;
-						tag = CODE_TAG_COMMENT;
+						tag = HIGHLIGHT_TAG_COMMENT;
 					}
 					break;
 					
 				case 5:
-					lex[lex_len++] = text[i];
+					lex_len++;
 					if (text[i] == '*') {
 						state = 6;
 					}
 					break;
 					
 				case 6:
-					lex[lex_len++] = text[i];
-					if (text[i] == '/' && text[i - 1] == '*') {
+					lex_len++;
+					if (text[i] == '/' && lex_len > 1 && text[i - 1] == '*') {
 						state = 0;
-						tag = CODE_TAG_COMMENT;
+						tag = HIGHLIGHT_TAG_COMMENT;
 					}
 					break;
 			}
 			
-			lex[lex_len] = 0;
-			
 			if (state != 0) {
 				continue;
 			}
 			
-			if (g_strcmp0 (tag, CODE_TAG_NONE) == 0) {
-				if (DIGIT (lex[0])) {
-					tag = CODE_TAG_CONSTANT;
+			if (tag == HIGHLIGHT_TAG_NONE && lex_len > 0) {
+				if (DIGIT (text[start_offset])) {
+					tag = HIGHLIGHT_TAG_CONSTANT;
 				}
-				else if (lex[0] == '#') {
-					tag = CODE_TAG_PREPROCESSOR;
+				else if (text[start_offset] == '#') {
+					tag = HIGHLIGHT_TAG_PREPROCESSOR;
 				}
-				else if (CHAR (lex[0]) && lex_len <= MAX_KEYWORD_LENGTH && highlight_is_keyword (lex)) {
-					tag = CODE_TAG_KEYWORD;
+				else if (CHAR (text[start_offset]) && lex_len <= MAX_KEYWORD_LENGTH &&
+						 keywords_is_keyword (text + start_offset, lex_len, job->dialects)) {
+					tag = HIGHLIGHT_TAG_KEYWORD;
 				}
 			}
 
-			if (g_strcmp0 (tag, CODE_TAG_NONE) != 0) {
-				glong utf8_start_offset = g_utf8_pointer_to_offset (text, text + start_offset);
-				glong utf8_lex_len = g_utf8_strlen (lex, lex_len);
-
-				highlight_add_tag (buffer, start, utf8_start_offset, utf8_lex_len, tag);
+			if (tag != HIGHLIGHT_TAG_NONE) {
+				highlight_span_add (job->spans, start_offset, lex_len, tag);
 			}
 
 			lex_len = 0;
 		}
 		else {
-			lex[lex_len++] = text[i];
+			lex_len++;
+			escape = FALSE;
 			if (state == 3) {
 				state = 0;
 			}
 		}		
 	}
 
-	if (state == 4 && lex_len > 0) {
-		glong utf8_start_offset = g_utf8_pointer_to_offset (text, text + start_offset);
-		glong utf8_lex_len = g_utf8_strlen (lex, lex_len);
+	if (!job->converged && i > recorded && i > 0 && text[i - 1] == '\n') {
+		line++;
+		line_state = state == 6? 5: state;
+		g_array_append_val (job->states, line_state);
+	}
 
-		highlight_add_tag (buffer, start, utf8_start_offset, utf8_lex_len, CODE_TAG_COMMENT);
+	/* Strings and comments may go on past the snapshot, tag what we have seen. */
+	if (state != 0 && state != 3 && lex_len > 0) {
+		highlight_span_add (job->spans, i - lex_len, lex_len,
+							state == 1 || state == 2? HIGHLIGHT_TAG_STRING: HIGHLIGHT_TAG_COMMENT);
 	}
-	
-	g_free ((gpointer) text);
+
+	job->lexed_lines = line;
+	highlight_spans_to_chars (text, job->spans, i, &job->chars);
+}
+
+static gpointer
+highlight_lex (gpointer data)
+{
+	highlight_lex_job ((CHighlightJob *) data);
+
+	g_idle_add (highlight_job_done, data);
+
+	return NULL;
+}
+
+/* Lex all of text in the calling thread, without any buffer, and append
+ * its spans in char offsets to spans. Returns the number of lines.
+ */
+gint
+highlight_lex_text (const gchar *text, GArray *spans, const gint dialects)
+{
+	CHighlightJob job;
+	guint8 state = HIGHLIGHT_STATE_CODE;
+
+	memset (&job, 0, sizeof (CHighlightJob));
+	job.text = (gchar *) text;
+	job.state = state;
+	job.dirty_lines = G_MAXINT;
+	job.to_end = TRUE;
+	job.old_states = &state;
+	job.old_len = 1;
+	job.states = g_array_new (FALSE, FALSE, sizeof (guint8));
+	g_array_append_val (job.states, state);
+	job.spans = spans;
+	job.dialects = dialects;
+
+	highlight_lex_job (&job);
+
+	g_array_free (job.states, TRUE);
+
+	return job.lexed_lines + 1;
+}
+
+static gboolean
+highlight_range_has_tag (GtkTextIter *start, GtkTextIter *end, GtkTextTag *tag)
+{
+	GtkTextIter toggle;
+
+	if (gtk_text_iter_has_tag (start, tag)) {
+		return TRUE;
+	}
+
+	toggle = *start;
+
+	return gtk_text_iter_forward_to_tag_toggle (&toggle, tag) &&
+		   gtk_text_iter_compare (&toggle, end) < 0;
+}
+
+static void
+highlight_retag (CHighlightCache *cache, GtkTextIter *iter, const gint len, const gint tag)
+{
+	/* Tag len chars at iter unless they are already tagged so, and move
+	 * iter past them. Unchanged text costs no buffer mutation at all.
+	 */
+	GtkTextIter start, toggle;
+	gboolean same;
+	gint i;
+
+	start = *iter;
+	gtk_text_iter_forward_chars (iter, len);
+
+	same = TRUE;
+	for (i = 0; i < HIGHLIGHT_TAG_COUNT && same; i++) {
+		same = gtk_text_iter_has_tag (&start, cache->tags[i]) == (i == tag);
+	}
+	if (same) {
+		toggle = start;
+		gtk_text_iter_forward_to_tag_toggle (&toggle, NULL);
+		same = gtk_text_iter_compare (&toggle, iter) >= 0;
+	}
+	if (same) {
+		return;
+	}
+
+	for (i = 0; i < HIGHLIGHT_TAG_COUNT; i++) {
+		if (i != tag && highlight_range_has_tag (&start, iter, cache->tags[i])) {
+			gtk_text_buffer_remove_tag (cache->buffer, cache->tags[i], &start, iter);
+		}
+	}
+	gtk_text_buffer_apply_tag (cache->buffer, cache->tags[tag], &start, iter);
+}
+
+static void
+highlight_apply_batch (CHighlightCache *cache, const gint base, const guint batch)
+{
+	/* Walk one iterator through the text covered by the spans of batch,
+	 * retagging spans and the gaps between them.
+	 */
+	GtkTextIter iter;
+	guint first, last;
+	gint offset, end_offset;
+
+	first = batch * HIGHLIGHT_SLICE_SPANS;
+	last = MIN (first + HIGHLIGHT_SLICE_SPANS, cache->spans->len);
+	offset = batch == 0? 0: g_array_index (cache->spans, CHighlightSpan, first).start;
+	if (last < cache->spans->len) {
+		end_offset = g_array_index (cache->spans, CHighlightSpan, last).start;
+	}
+	else {
+		end_offset = cache->apply_chars;
+	}
+
+	gtk_text_buffer_get_iter_at_offset (cache->buffer, &iter, base + offset);
+
+	for (; first <= last; first++) {
+		CHighlightSpan *span;
+		gint gap_end;
+
+		span = first < last? &g_array_index (cache->spans, CHighlightSpan, first): NULL;
+		gap_end = span != NULL? span->start: end_offset;
+		if (gap_end > offset) {
+			highlight_retag (cache, &iter, gap_end - offset, HIGHLIGHT_TAG_NONE);
+			offset = gap_end;
+		}
+
+		if (span != NULL) {
+			highlight_retag (cache, &iter, span->len, span->tag);
+			offset += span->len;
+		}
+	}
+
+	cache->batches[batch] = TRUE;
+	cache->batches_left--;
+}
+
+static guint
+highlight_find_batch (GArray *spans, const gint offset)
+{
+	/* Batch of the first span ending after offset. */
+	guint low, high;
+
+	low = 0;
+	high = spans->len;
+	while (low < high) {
+		guint mid;
+		CHighlightSpan *span;
+
+		mid = (low + high) / 2;
+		span = &g_array_index (spans, CHighlightSpan, mid);
+		if (span->start + span->len <= offset) {
+			low = mid + 1;
+		}
+		else {
+			high = mid;
+		}
+	}
+
+	return MIN (low, MAX (spans->len, 1) - 1) / HIGHLIGHT_SLICE_SPANS;
+}
+
+static void
+highlight_apply_visible (CHighlightCache *cache, const gint base)
+{
+	/* Spans on screen come first, whatever order they were lexed in. */
+	GdkRectangle rect;
+	GtkTextIter iter;
+	gint first_line, last_line;
+	guint first, last;
+
+	/* A new tab is not laid out yet, it will show the first lines. */
+	if (cache->view != NULL && gtk_widget_get_realized (GTK_WIDGET (cache->view))) {
+		gtk_text_view_get_visible_rect (cache->view, &rect);
+		gtk_text_view_get_line_at_y (cache->view, &iter, rect.y, NULL);
+		first_line = gtk_text_iter_get_line (&iter) - HIGHLIGHT_VIEW_MARGIN;
+		gtk_text_view_get_line_at_y (cache->view, &iter, rect.y + rect.height, NULL);
+		last_line = gtk_text_iter_get_line (&iter) + HIGHLIGHT_VIEW_MARGIN;
+	}
+	else {
+		first_line = 0;
+		last_line = 2 * HIGHLIGHT_VIEW_MARGIN;
+	}
+
+	first_line = MAX (first_line, cache->apply_line);
+	last_line = MIN (last_line, cache->apply_end_line);
+	if (first_line > last_line) {
+		return;
+	}
+
+	gtk_text_buffer_get_iter_at_line (cache->buffer, &iter, first_line);
+	first = highlight_find_batch (cache->spans, gtk_text_iter_get_offset (&iter) - base);
+	gtk_text_buffer_get_iter_at_line (cache->buffer, &iter, last_line);
+	gtk_text_iter_forward_to_line_end (&iter);
+	last = highlight_find_batch (cache->spans, gtk_text_iter_get_offset (&iter) - base);
+
+	for (; first <= last; first++) {
+		if (!cache->batches[first]) {
+			highlight_apply_batch (cache, base, first);
+		}
+	}
+}
+
+static gboolean
+highlight_apply_slice (gpointer data)
+{
+	/* Apply spans in batches until the time budget of this slice is used up. */
+	CHighlightCache *cache;
+	GtkTextIter line_start;
+	gint64 deadline;
+	gint base;
+
+	cache = (CHighlightCache *) data;
+
+	/* The buffer changed, the remaining spans are stale. */
+	if (cache->revision != cache->apply_revision) {
+		cache->apply_id = 0;
+		highlight_cache_drop_apply (cache);
+		highlight_update (cache);
+
+		return FALSE;
+	}
+
+	gtk_text_buffer_get_iter_at_line (cache->buffer, &line_start, cache->apply_line);
+	base = gtk_text_iter_get_offset (&line_start);
+	deadline = g_get_monotonic_time () + HIGHLIGHT_SLICE_TIME;
+
+	highlight_apply_visible (cache, base);
+
+	while (cache->batches_left > 0 && g_get_monotonic_time () < deadline) {
+		while (cache->batches[cache->next_batch]) {
+			cache->next_batch++;
+		}
+
+		highlight_apply_batch (cache, base, cache->next_batch);
+	}
+
+	if (cache->batches_left > 0) {
+		return TRUE;
+	}
+
+	cache->apply_id = 0;
+	highlight_cache_cancel_apply (cache);
+
+	if (cache->apply_converged) {
+		cache->dirty_start = -1;
+		cache->dirty_end = -1;
+	}
+	else {
+		cache->dirty_start = cache->apply_end_line;
+		cache->dirty_end = MAX (cache->dirty_end, cache->apply_end_line);
+		highlight_update (cache);
+	}
+
+	return FALSE;
+}
+
+static void
+highlight_cache_apply (CHighlightCache *cache, GArray *spans, const gint start_line,
+					   const gint lines, const gint chars, const gboolean converged)
+{
+	/* Take spans over and start applying them from start_line on. Dirty
+	 * lines stay dirty until all spans are applied.
+	 */
+	cache->spans = spans;
+	cache->batches_left = MAX (1, (spans->len + HIGHLIGHT_SLICE_SPANS - 1) / HIGHLIGHT_SLICE_SPANS);
+	cache->batches = (gboolean *) g_malloc0 (cache->batches_left * sizeof (gboolean));
+	cache->next_batch = 0;
+	cache->apply_revision = cache->revision;
+	cache->apply_line = start_line;
+	cache->apply_chars = chars;
+	cache->apply_end_line = start_line + lines;
+	cache->apply_converged = converged;
+
+	/* The first slice runs right away so the visible lines are coloured now. */
+	if (highlight_apply_slice ((gpointer) cache)) {
+		cache->apply_id = g_idle_add (highlight_apply_slice, (gpointer) cache);
+	}
+}
+
+static gboolean
+highlight_job_done (gpointer data)
+{
+	CHighlightJob *job;
+	CHighlightCache *cache;
+	gint start_line;
+	guint i;
+
+	job = (CHighlightJob *) data;
+	cache = job->cache;
+	cache->lexing = FALSE;
+
+	if (cache->freed) {
+		highlight_job_free (job);
+		highlight_cache_destroy (cache);
+
+		return FALSE;
+	}
+
+	/* Never apply spans lexed from an older revision of the buffer. */
+	if (job->revision != cache->revision) {
+		highlight_job_free (job);
+		highlight_update (cache);
+
+		return FALSE;
+	}
+
+	start_line = cache->dirty_start;
+	for (i = 1; i < job->states->len && start_line + i < cache->line_states->len; i++) {
+		g_array_index (cache->line_states, guint8, start_line + i) =
+			g_array_index (job->states, guint8, i);
+	}
+
+	/* The first lexing of a loaded file covers all of it unless it was edited. */
+	if (cache->store_path != NULL) {
+		if (job->revision == cache->store_revision && start_line == 0 && job->to_end) {
+			spancache_store (cache->store_path, cache->store_hash, job->dialects,
+							 job->states, job->spans, job->chars);
+		}
+
+		g_free ((gpointer) cache->store_path);
+		cache->store_path = NULL;
+	}
+
+	highlight_cache_apply (cache, job->spans, start_line, job->lexed_lines, job->chars,
+						   job->converged || job->to_end);
+	job->spans = NULL;
+
+	highlight_job_free (job);
+
+	return FALSE;
+}
+
+/* Highlight a file just loaded into the empty buffer of cache from spans
+ * cached for the same content, or else remember to cache the spans of its
+ * first lexing. Returns FALSE if the buffer still has to be lexed.
+ */
+gboolean
+highlight_cache_load (CHighlightCache *cache, const gchar *filepath, const gchar *text)
+{
+	const CSpanCacheEntry *entry;
+	GArray *spans;
+	guint64 hash;
+	gint dialects;
+
+	hash = spancache_hash (text, strlen (text));
+	dialects = highlight_dialects ();
+
+	entry = spancache_lookup (filepath, hash, dialects);
+	if (entry == NULL || entry->states->len != cache->line_states->len) {
+		g_free ((gpointer) cache->store_path);
+		cache->store_path = g_strdup (filepath);
+		cache->store_hash = hash;
+		cache->store_revision = cache->revision;
+
+		return FALSE;
+	}
+
+	g_array_set_size (cache->line_states, 0);
+	g_array_append_vals (cache->line_states, entry->states->data, entry->states->len);
+
+	spans = g_array_sized_new (FALSE, FALSE, sizeof (CHighlightSpan), entry->spans->len);
+	g_array_append_vals (spans, entry->spans->data, entry->spans->len);
+	highlight_cache_apply (cache, spans, 0, entry->states->len - 1, entry->chars, TRUE);
+
+	return TRUE;
+}
+
+/* Lex dirty lines of the buffer of cache in a worker thread. Spans are
+ * applied afterwards in short idle slices, those on screen first, and
+ * dropped as soon as the buffer is edited again.
+ */
+void
+highlight_update (CHighlightCache *cache)
+{
+	CHighlightJob *job;
+	GtkTextIter start, end;
+	gint line_count;
+	gint start_line;
+	gint lines;
+	gint old_len;
+
+	if (cache->dirty_start == -1 || cache->lexing) {
+		return;
+	}
+
+	if (cache->spans != NULL) {
+		if (cache->apply_revision == cache->revision) {
+			return;
+		}
+
+		highlight_cache_drop_apply (cache);
+	}
+
+	line_count = gtk_text_buffer_get_line_count (cache->buffer);
+	if ((gint) cache->line_states->len != line_count) {
+		g_warning ("highlight cache is out of sync with buffer, rebuilding it.");
+
+		g_array_set_size (cache->line_states, line_count);
+		cache->dirty_start = 0;
+		cache->dirty_end = line_count - 1;
+	}
+
+	start_line = MIN (cache->dirty_start, line_count - 1);
+	cache->dirty_start = start_line;
+	cache->dirty_end = CLAMP (cache->dirty_end, start_line, line_count - 1);
+	lines = MIN (line_count - start_line,
+				 cache->dirty_end - start_line + 1 + HIGHLIGHT_LOOKAHEAD_LINES);
+
+	gtk_text_buffer_get_iter_at_line (cache->buffer, &start, start_line);
+	if (start_line + lines < line_count) {
+		gtk_text_buffer_get_iter_at_line (cache->buffer, &end, start_line + lines);
+	}
+	else {
+		gtk_text_buffer_get_end_iter (cache->buffer, &end);
+	}
+
+	old_len = MIN (lines + 1, line_count - start_line);
+
+	job = (CHighlightJob *) g_malloc0 (sizeof (CHighlightJob));
+	job->cache = cache;
+	job->text = gtk_text_iter_get_text (&start, &end);
+	job->state = g_array_index (cache->line_states, guint8, start_line);
+	job->dirty_lines = cache->dirty_end - start_line;
+	job->to_end = start_line + lines == line_count;
+	job->revision = cache->revision;
+	job->old_states = (guint8 *) g_malloc (old_len);
+	memcpy (job->old_states, cache->line_states->data + start_line, old_len);
+	job->old_len = old_len;
+	job->states = g_array_new (FALSE, FALSE, sizeof (guint8));
+	g_array_append_val (job->states, job->old_states[0]);
+	job->spans = g_array_new (FALSE, FALSE, sizeof (CHighlightSpan));
+	job->dialects = highlight_dialects ();
+
+	cache->lexing = TRUE;
+	g_thread_unref (g_thread_new ("highlight", highlight_lex, (gpointer) job));
 }
 
 void
@@ -287,14 +1016,10 @@ highlight_parse (gpointer data)
 
 	editor = ui_get_current_editor ();
 	if (editor != NULL) {
-		GtkTextBuffer *buffer;
-		GtkTextIter start, end;
-		
-		buffer = gtk_text_view_get_buffer (GTK_TEXT_VIEW (editor->textview));
-		gtk_text_buffer_get_start_iter (buffer, &start);
-		gtk_text_buffer_get_end_iter (buffer, &end);
-
-		highlight_apply (buffer, &start, &end);
+		/* Large files are not highlighted. */
+		if (editor->highlight_cache != NULL) {
+			highlight_update (editor->highlight_cache);
+		}
 
 		ui_current_editor_set_need_highlight (FALSE);
 
@@ -34,9 +34,84 @@ c == '(' || c == ')')
 
 #define SPACE(c) (c == ' ' || c == '\n' || c == '\t')
 
+/* Lexer states, see highlight_lex (). */
+#define HIGHLIGHT_STATE_CODE 0
+#define HIGHLIGHT_STATE_STRING 1
+#define HIGHLIGHT_STATE_CHAR 2
+#define HIGHLIGHT_STATE_COMMENT_START 3
+#define HIGHLIGHT_STATE_LINE_COMMENT 4
+#define HIGHLIGHT_STATE_BLOCK_COMMENT 5
+#define HIGHLIGHT_STATE_BLOCK_COMMENT_STAR 6
+
+/* Token classes produced by the lexer. */
+#define HIGHLIGHT_TAG_NONE 0
+#define HIGHLIGHT_TAG_PREPROCESSOR 1
+#define HIGHLIGHT_TAG_KEYWORD 2
+#define HIGHLIGHT_TAG_CONSTANT 3
+#define HIGHLIGHT_TAG_STRING 4
+#define HIGHLIGHT_TAG_COMMENT 5
+#define HIGHLIGHT_TAG_COUNT 6
+
+typedef struct {
+	gint start;
+	gint len;
+	gint tag;
+} CHighlightSpan;
+
+/* Lexer state at the start of every line of a buffer, the range of lines
+ * edited since they were last highlighted, the spans of the last lexing
+ * result still being applied to the buffer, and the file whose spans are
+ * to be cached once lexed.
+ */
+typedef struct {
+	GtkTextView *view;
+	GtkTextBuffer *buffer;
+	GtkTextTag *tags[HIGHLIGHT_TAG_COUNT];
+	GArray *line_states;
+	gint dirty_start;
+	gint dirty_end;
+	guint revision;
+	gboolean lexing;
+	gboolean freed;
+	GArray *spans;
+	gboolean *batches;
+	guint batches_left;
+	guint next_batch;
+	guint apply_id;
+	guint apply_revision;
+	gint apply_line;
+	gint apply_chars;
+	gint apply_end_line;
+	gboolean apply_converged;
+	gchar *store_path;
+	guint64 store_hash;
+	guint store_revision;
+} CHighlightCache;
+
 void
 highlight_init ();
 
+CHighlightCache *
+highlight_cache_new (GtkTextView *view);
+
+CHighlightCache *
+highlight_cache_new_with_buffer (GtkTextBuffer *buffer);
+
+void
+highlight_cache_free (CHighlightCache *cache);
+
+void
+highlight_cache_insert_lines (CHighlightCache *cache, const gint line, const gint lines);
+
+void
+highlight_cache_remove_lines (CHighlightCache *cache, const gint line, const gint lines);
+
+gboolean
+highlight_cache_load (CHighlightCache *cache, const gchar *filepath, const gchar *text);
+
+void
+highlight_cache_invalidate (CHighlightCache *cache, const gint start_line, const gint end_line);
+
 void
 highlight_register (GtkTextBuffer *buffer);
 
@@ -48,8 +123,10 @@ highlight_add_tag (GtkTextBuffer *buffer, GtkTextIter *startitr,
 				   gint offset, gint len, gchar *tag);
 
 void
-highlight_apply (GtkTextBuffer *buffer, GtkTextIter *start,
-				 GtkTextIter *end);
+highlight_update (CHighlightCache *cache);
+
+gint
+highlight_lex_text (const gchar *text, GArray *spans, const gint dialects);
 
 void
 highlight_set_tab (GtkTextView *buffer);
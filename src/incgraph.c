@@ -0,0 +1,359 @@
+/*
+ * incgraph.c
+ * This file is part of codefox
+ *
+ * Copyright (C) 2012-2017 - Gordon Li
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <string.h>
+
+#include "incgraph.h"
+
+/* One file of the graph. Edges go both ways so that the files reached
+ * from a header, and those it reaches, are both a walk away.
+ */
+typedef struct {
+	gchar *path;
+	GPtrArray *includes;
+	GPtrArray *included_by;
+	gboolean scanned;
+} CIncNode;
+
+/* Nodes by path, fed from the indexer pool and the main loop alike. */
+static GHashTable *incgraph_nodes;
+static gchar *incgraph_root;
+static GMutex incgraph_mutex;
+
+static void
+incgraph_node_free (gpointer data)
+{
+	CIncNode *node = (CIncNode *) data;
+
+	g_free ((gpointer) node->path);
+	g_ptr_array_free (node->includes, TRUE);
+	g_ptr_array_free (node->included_by, TRUE);
+	g_free (data);
+}
+
+static CIncNode *
+incgraph_node (const gchar *filepath)
+{
+	CIncNode *node;
+
+	node = (CIncNode *) g_hash_table_lookup (incgraph_nodes, filepath);
+	if (node == NULL) {
+		node = (CIncNode *) g_malloc (sizeof (CIncNode));
+		node->path = g_strdup (filepath);
+		node->includes = g_ptr_array_new ();
+		node->included_by = g_ptr_array_new ();
+		node->scanned = FALSE;
+		g_hash_table_insert (incgraph_nodes, node->path, node);
+	}
+
+	return node;
+}
+
+void
+incgraph_init ()
+{
+	incgraph_nodes = g_hash_table_new_full (g_str_hash, g_str_equal, NULL, incgraph_node_free);
+	incgraph_root = NULL;
+	g_mutex_init (&incgraph_mutex);
+}
+
+/* Forgets every file, angle bracket includes are looked up in project_path
+ * from now on.
+ */
+void
+incgraph_reset (const gchar *project_path)
+{
+	g_mutex_lock (&incgraph_mutex);
+	g_hash_table_remove_all (incgraph_nodes);
+	g_free ((gpointer) incgraph_root);
+	incgraph_root = g_strdup (project_path);
+	g_mutex_unlock (&incgraph_mutex);
+}
+
+gboolean
+incgraph_scanned (const gchar *filepath)
+{
+	CIncNode *node;
+	gboolean scanned;
+
+	g_mutex_lock (&incgraph_mutex);
+	node = (CIncNode *) g_hash_table_lookup (incgraph_nodes, filepath);
+	scanned = node != NULL && node->scanned;
+	g_mutex_unlock (&incgraph_mutex);
+
+	return scanned;
+}
+
+/* Joins dir and name, dropping "." and folding ".." so that one file
+ * always gets the same key however it is included.
+ */
+static gchar *
+incgraph_join (const gchar *dir, const gchar *name)
+{
+	gchar *joined;
+	gchar **parts;
+	GPtrArray *kept;
+	gchar *path;
+	gint i;
+
+	joined = g_build_filename (dir, name, NULL);
+	parts = g_strsplit (joined, G_DIR_SEPARATOR_S, -1);
+	kept = g_ptr_array_new ();
+	for (i = 0; parts[i]; i++) {
+		if (parts[i][0] == 0 || g_strcmp0 (parts[i], ".") == 0) {
+			continue;
+		}
+		if (g_strcmp0 (parts[i], "..") == 0) {
+			if (kept->len > 0) {
+				g_ptr_array_remove_index (kept, kept->len - 1);
+			}
+			continue;
+		}
+		g_ptr_array_add (kept, parts[i]);
+	}
+	g_ptr_array_add (kept, NULL);
+
+	path = g_strjoinv (G_DIR_SEPARATOR_S, (gchar **) kept->pdata);
+	if (g_path_is_absolute (joined)) {
+		gchar *absolute;
+
+		absolute = g_strconcat (G_DIR_SEPARATOR_S, path, NULL);
+		g_free ((gpointer) path);
+		path = absolute;
+	}
+
+	g_ptr_array_free (kept, TRUE);
+	g_strfreev (parts);
+	g_free ((gpointer) joined);
+
+	return path;
+}
+
+/* Where an include of name from the file in dir lands, NULL for a system
+ * header or a missing file. Quoted names are tried next to the includer
+ * first, then in the project directory.
+ */
+static gchar *
+incgraph_resolve (const gchar *root, const gchar *dir, const gchar *name,
+				  const gboolean quoted)
+{
+	gchar *path;
+
+	if (quoted) {
+		path = incgraph_join (dir, name);
+		if (g_file_test (path, G_FILE_TEST_IS_REGULAR)) {
+			return path;
+		}
+		g_free ((gpointer) path);
+	}
+
+	if (root != NULL) {
+		path = incgraph_join (root, name);
+		if (g_file_test (path, G_FILE_TEST_IS_REGULAR)) {
+			return path;
+		}
+		g_free ((gpointer) path);
+	}
+
+	return NULL;
+}
+
+/* Replaces the includes of filepath with those found in content. */
+void
+incgraph_update (const gchar *filepath, const gchar *content, const gsize len)
+{
+	const gchar *line;
+	const gchar *end;
+	GPtrArray *paths;
+	CIncNode *node;
+	gchar *root;
+	gchar *dir;
+	guint i;
+
+	/* Resolving touches the disk, do it out of the lock. */
+	g_mutex_lock (&incgraph_mutex);
+	root = g_strdup (incgraph_root);
+	g_mutex_unlock (&incgraph_mutex);
+
+	dir = g_path_get_dirname (filepath);
+	paths = g_ptr_array_new_with_free_func (g_free);
+	end = content + len;
+	for (line = content; line < end; line++) {
+		const gchar *next;
+		const gchar *p;
+		const gchar *close;
+		gchar *name;
+		gchar *path;
+
+		next = memchr (line, '\n', end - line);
+		if (next == NULL) {
+			next = end;
+		}
+
+		for (p = line; p < next && (*p == ' ' || *p == '\t'); p++) {
+		}
+		if (p == next || *p != '#') {
+			line = next;
+			continue;
+		}
+		for (p++; p < next && (*p == ' ' || *p == '\t'); p++) {
+		}
+		if (next - p < 7 || memcmp (p, "include", 7) != 0) {
+			line = next;
+			continue;
+		}
+		for (p += 7; p < next && (*p == ' ' || *p == '\t'); p++) {
+		}
+		if (p == next || (*p != '"' && *p != '<')) {
+			line = next;
+			continue;
+		}
+
+		close = memchr (p + 1, *p == '"'? '"': '>', next - p - 1);
+		if (close == NULL) {
+			line = next;
+			continue;
+		}
+
+		name = g_strndup (p + 1, close - p - 1);
+		path = incgraph_resolve (root, dir, name, *p == '"');
+		if (path != NULL) {
+			g_ptr_array_add (paths, path);
+		}
+		g_free ((gpointer) name);
+
+		line = next;
+	}
+	g_free ((gpointer) dir);
+	g_free ((gpointer) root);
+
+	g_mutex_lock (&incgraph_mutex);
+	node = incgraph_node (filepath);
+	for (i = 0; i < node->includes->len; i++) {
+		CIncNode *included = (CIncNode *) node->includes->pdata[i];
+
+		g_ptr_array_remove_fast (included->included_by, node);
+	}
+	g_ptr_array_set_size (node->includes, 0);
+
+	for (i = 0; i < paths->len; i++) {
+		CIncNode *included;
+		guint j;
+
+		included = incgraph_node ((const gchar *) paths->pdata[i]);
+		for (j = 0; j < node->includes->len && node->includes->pdata[j] != included; j++) {
+		}
+		if (included == node || j < node->includes->len) {
+			continue;
+		}
+		g_ptr_array_add (node->includes, included);
+		g_ptr_array_add (included->included_by, node);
+	}
+	node->scanned = TRUE;
+	g_mutex_unlock (&incgraph_mutex);
+
+	g_ptr_array_free (paths, TRUE);
+}
+
+/* Drops the includes of a file gone from the project. It stays a node
+ * while other files still include it.
+ */
+void
+incgraph_remove (const gchar *filepath)
+{
+	CIncNode *node;
+	guint i;
+
+	g_mutex_lock (&incgraph_mutex);
+	node = (CIncNode *) g_hash_table_lookup (incgraph_nodes, filepath);
+	if (node != NULL) {
+		for (i = 0; i < node->includes->len; i++) {
+			CIncNode *included = (CIncNode *) node->includes->pdata[i];
+
+			g_ptr_array_remove_fast (included->included_by, node);
+		}
+		g_ptr_array_set_size (node->includes, 0);
+		node->scanned = FALSE;
+
+		if (node->included_by->len == 0) {
+			g_hash_table_remove (incgraph_nodes, filepath);
+		}
+	}
+	g_mutex_unlock (&incgraph_mutex);
+}
+
+/* Every file reached from filepath along edges, itself excluded, as
+ * copied paths in breadth first order.
+ */
+static GList *
+incgraph_walk (const gchar *filepath, const gboolean dependents)
+{
+	CIncNode *node;
+	GHashTable *seen;
+	GQueue queue = G_QUEUE_INIT;
+	GList *result;
+
+	result = NULL;
+	g_mutex_lock (&incgraph_mutex);
+	node = (CIncNode *) g_hash_table_lookup (incgraph_nodes, filepath);
+	if (node == NULL) {
+		g_mutex_unlock (&incgraph_mutex);
+
+		return NULL;
+	}
+
+	seen = g_hash_table_new (g_direct_hash, g_direct_equal);
+	g_hash_table_add (seen, node);
+	g_queue_push_tail (&queue, node);
+	while ((node = (CIncNode *) g_queue_pop_head (&queue)) != NULL) {
+		GPtrArray *edges;
+		guint i;
+
+		edges = dependents? node->included_by: node->includes;
+		for (i = 0; i < edges->len; i++) {
+			CIncNode *next = (CIncNode *) edges->pdata[i];
+
+			if (g_hash_table_contains (seen, next)) {
+				continue;
+			}
+			g_hash_table_add (seen, next);
+			g_queue_push_tail (&queue, next);
+			result = g_list_prepend (result, g_strdup (next->path));
+		}
+	}
+	g_hash_table_destroy (seen);
+	g_mutex_unlock (&incgraph_mutex);
+
+	return g_list_reverse (result);
+}
+
+/* The files that include filepath, directly or not. */
+GList *
+incgraph_dependents (const gchar *filepath)
+{
+	return incgraph_walk (filepath, TRUE);
+}
+
+/* The files filepath includes, directly or not. */
+GList *
+incgraph_includes (const gchar *filepath)
+{
+	return incgraph_walk (filepath, FALSE);
+}
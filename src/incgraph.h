@@ -0,0 +1,47 @@
+/*
+ * incgraph.h
+ * This file is part of codefox
+ *
+ * Copyright (C) 2012-2017 - Gordon Li
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef INCGRAPH_H
+#define INCGRAPH_H
+
+#include <gtk/gtk.h>
+
+void
+incgraph_init ();
+
+void
+incgraph_reset (const gchar *project_path);
+
+gboolean
+incgraph_scanned (const gchar *filepath);
+
+void
+incgraph_update (const gchar *filepath, const gchar *content, const gsize len);
+
+void
+incgraph_remove (const gchar *filepath);
+
+GList *
+incgraph_dependents (const gchar *filepath);
+
+GList *
+incgraph_includes (const gchar *filepath);
+
+#endif /* INCGRAPH_H */
@@ -28,134 +28,172 @@
 
 #include "keywords.h"
 
-/* All C/C++ keywords. */
-static gchar *keywords[] = 
-{
-	"asm", "auto", "bad_cast",
-	"bad_typeid", "bool", "break", "case", "catch", "char", "class",
-	"const", "const_cast", "continue", "default", "delete", "do",
-	"double", "dynamic_cast", "else", "enum", "except", "explicit",
-	"extern", "false", "finally", "float", "for", "friend", "goto",
-	"if", "inline", "int", "long", "mutable", "namespace", "new",
-	"operator", "private", "protected", "public", "register",
-	"reinterpret_cast", "return", "short", "signed", "sizeof",
-	"static", "static_cast", "struct", "switch", "template", "this",
-	"throw", "true", "try", "type_info", "typedef", "typeid",
-	"typename", "union", "unsigned", "using", "virtual", "void",
-	"volatile", "wchar_t", "while", NULL,
-};
+#define MIN_KEYWORD_LENGTH 2
 
-typedef struct Trie {
-	struct Trie *sub[256];
-	gint flag;
-} CTrie;
+#define KEYWORDS_TABLE_SIZE 256
 
-static CTrie *trie;
-
-static CTrie *
-keywords_trie_create ()
-{
-	CTrie *ret = (CTrie *) g_malloc (sizeof (CTrie));
-	
-	if (!ret) {
-		g_error ("faild to create trie.");
+typedef struct {
+	const gchar *word;
+	gint len;
+	gint dialects;
+} CKeyword;
 
-		return NULL;
-	}
+/* Perfect hash of the C (up to C23) and C++ (up to C++20) keywords, see
+ * keywords_hash (). A character not used by any keyword weighs 0.
+ */
+static const guint8 asso[256] = {
+	  0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,
+	  0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,
+	  0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,
+	  0, 238, 238,   0, 189,   0,   0,   0,  85,   0,   0,   0,   0,   0,   0,   0,
+	  0, 175,  41, 134,  37,   0,   0, 217,   0,  58,   0,   0,   0,   0, 164,   0,
+	  0,   0,   0,  51,  12,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   6,
+	  0, 110, 233, 143,  93,  11,  81,  32,  71, 192,   0, 154,  67,  70,  46, 107,
+	191, 125, 246, 232, 160, 204,  18,  94, 210,   1,   0,   0,   0,   0,   0,   0,
+	  0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,
+	  0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,
+	  0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,
+	  0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,
+	  0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,
+	  0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,
+	  0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,
+	  0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,
+};
 
-	memset (ret, 0, sizeof(CTrie));
-	
-	return ret;
-}
+static const CKeyword keywords[KEYWORDS_TABLE_SIZE] = {
+	[0] = {"co_await", 8, KEYWORDS_CPP},
+	[1] = {"template", 8, KEYWORDS_CPP},
+	[7] = {"extern", 6, KEYWORDS_C | KEYWORDS_CPP},
+	[13] = {"mutable", 7, KEYWORDS_CPP},
+	[16] = {"_BitInt", 7, KEYWORDS_C},
+	[20] = {"auto", 4, KEYWORDS_C | KEYWORDS_CPP},
+	[22] = {"signed", 6, KEYWORDS_C | KEYWORDS_CPP},
+	[23] = {"case", 4, KEYWORDS_C | KEYWORDS_CPP},
+	[24] = {"break", 5, KEYWORDS_C | KEYWORDS_CPP},
+	[25] = {"delete", 6, KEYWORDS_CPP},
+	[27] = {"decltype", 8, KEYWORDS_CPP},
+	[28] = {"double", 6, KEYWORDS_C | KEYWORDS_CPP},
+	[31] = {"co_yield", 8, KEYWORDS_CPP},
+	[34] = {"switch", 6, KEYWORDS_C | KEYWORDS_CPP},
+	[37] = {"_Complex", 8, KEYWORDS_C},
+	[38] = {"protected", 9, KEYWORDS_CPP},
+	[39] = {"not_eq", 6, KEYWORDS_CPP},
+	[42] = {"and_eq", 6, KEYWORDS_CPP},
+	[43] = {"return", 6, KEYWORDS_C | KEYWORDS_CPP},
+	[44] = {"xor", 3, KEYWORDS_CPP},
+	[45] = {"inline", 6, KEYWORDS_C | KEYWORDS_CPP},
+	[46] = {"_Alignof", 8, KEYWORDS_C},
+	[48] = {"volatile", 8, KEYWORDS_C | KEYWORDS_CPP},
+	[49] = {"int", 3, KEYWORDS_C | KEYWORDS_CPP},
+	[53] = {"private", 7, KEYWORDS_CPP},
+	[55] = {"alignof", 7, KEYWORDS_C | KEYWORDS_CPP},
+	[58] = {"bitand", 6, KEYWORDS_CPP},
+	[59] = {"void", 4, KEYWORDS_C | KEYWORDS_CPP},
+	[60] = {"co_return", 9, KEYWORDS_CPP},
+	[63] = {"const", 5, KEYWORDS_C | KEYWORDS_CPP},
+	[67] = {"constinit", 9, KEYWORDS_CPP},
+	[68] = {"const_cast", 10, KEYWORDS_CPP},
+	[69] = {"explicit", 8, KEYWORDS_CPP},
+	[75] = {"_Decimal128", 11, KEYWORDS_C},
+	[79] = {"or", 2, KEYWORDS_CPP},
+	[80] = {"dynamic_cast", 12, KEYWORDS_CPP},
+	[81] = {"reinterpret_cast", 16, KEYWORDS_CPP},
+	[86] = {"typedef", 7, KEYWORDS_C | KEYWORDS_CPP},
+	[89] = {"and", 3, KEYWORDS_CPP},
+	[91] = {"union", 5, KEYWORDS_C | KEYWORDS_CPP},
+	[92] = {"typeof_unqual", 13, KEYWORDS_C},
+	[96] = {"or_eq", 5, KEYWORDS_CPP},
+	[99] = {"typeof", 6, KEYWORDS_C},
+	[101] = {"goto", 4, KEYWORDS_C | KEYWORDS_CPP},
+	[104] = {"else", 4, KEYWORDS_C | KEYWORDS_CPP},
+	[106] = {"sizeof", 6, KEYWORDS_C | KEYWORDS_CPP},
+	[107] = {"_Imaginary", 10, KEYWORDS_C},
+	[108] = {"char16_t", 8, KEYWORDS_CPP},
+	[109] = {"_Thread_local", 13, KEYWORDS_C},
+	[116] = {"short", 5, KEYWORDS_C | KEYWORDS_CPP},
+	[121] = {"export", 6, KEYWORDS_CPP},
+	[126] = {"char32_t", 8, KEYWORDS_CPP},
+	[127] = {"unsigned", 8, KEYWORDS_C | KEYWORDS_CPP},
+	[129] = {"_Generic", 8, KEYWORDS_C},
+	[133] = {"compl", 5, KEYWORDS_CPP},
+	[134] = {"override", 8, KEYWORDS_CPP},
+	[135] = {"_Static_assert", 14, KEYWORDS_C},
+	[138] = {"wchar_t", 7, KEYWORDS_CPP},
+	[144] = {"catch", 5, KEYWORDS_CPP},
+	[145] = {"_Atomic", 7, KEYWORDS_C},
+	[150] = {"operator", 8, KEYWORDS_CPP},
+	[152] = {"namespace", 9, KEYWORDS_CPP},
+	[153] = {"constexpr", 9, KEYWORDS_C | KEYWORDS_CPP},
+	[154] = {"bitor", 5, KEYWORDS_CPP},
+	[155] = {"try", 3, KEYWORDS_CPP},
+	[156] = {"final", 5, KEYWORDS_CPP},
+	[159] = {"restrict", 8, KEYWORDS_C},
+	[160] = {"do", 2, KEYWORDS_C | KEYWORDS_CPP},
+	[164] = {"thread_local", 12, KEYWORDS_C | KEYWORDS_CPP},
+	[167] = {"class", 5, KEYWORDS_CPP},
+	[168] = {"throw", 5, KEYWORDS_CPP},
+	[171] = {"for", 3, KEYWORDS_C | KEYWORDS_CPP},
+	[172] = {"concept", 7, KEYWORDS_CPP},
+	[176] = {"true", 4, KEYWORDS_C | KEYWORDS_CPP},
+	[177] = {"requires", 8, KEYWORDS_CPP},
+	[178] = {"_Decimal64", 10, KEYWORDS_C},
+	[181] = {"if", 2, KEYWORDS_C | KEYWORDS_CPP},
+	[182] = {"nullptr", 7, KEYWORDS_C | KEYWORDS_CPP},
+	[186] = {"_Bool", 5, KEYWORDS_C},
+	[187] = {"this", 4, KEYWORDS_CPP},
+	[189] = {"struct", 6, KEYWORDS_C | KEYWORDS_CPP},
+	[192] = {"while", 5, KEYWORDS_C | KEYWORDS_CPP},
+	[196] = {"typeid", 6, KEYWORDS_CPP},
+	[197] = {"_Alignas", 8, KEYWORDS_C},
+	[198] = {"char", 4, KEYWORDS_C | KEYWORDS_CPP},
+	[201] = {"enum", 4, KEYWORDS_C | KEYWORDS_CPP},
+	[203] = {"xor_eq", 6, KEYWORDS_CPP},
+	[205] = {"continue", 8, KEYWORDS_C | KEYWORDS_CPP},
+	[206] = {"alignas", 7, KEYWORDS_C | KEYWORDS_CPP},
+	[208] = {"noexcept", 8, KEYWORDS_CPP},
+	[210] = {"char8_t", 7, KEYWORDS_CPP},
+	[216] = {"friend", 6, KEYWORDS_CPP},
+	[217] = {"float", 5, KEYWORDS_C | KEYWORDS_CPP},
+	[218] = {"false", 5, KEYWORDS_C | KEYWORDS_CPP},
+	[219] = {"default", 7, KEYWORDS_C | KEYWORDS_CPP},
+	[220] = {"not", 3, KEYWORDS_CPP},
+	[221] = {"static", 6, KEYWORDS_C | KEYWORDS_CPP},
+	[222] = {"bool", 4, KEYWORDS_C | KEYWORDS_CPP},
+	[224] = {"public", 6, KEYWORDS_CPP},
+	[226] = {"typename", 8, KEYWORDS_CPP},
+	[227] = {"_Decimal32", 10, KEYWORDS_C},
+	[229] = {"asm", 3, KEYWORDS_CPP},
+	[230] = {"consteval", 9, KEYWORDS_CPP},
+	[231] = {"register", 8, KEYWORDS_C | KEYWORDS_CPP},
+	[232] = {"virtual", 7, KEYWORDS_CPP},
+	[236] = {"_Noreturn", 9, KEYWORDS_C},
+	[242] = {"long", 4, KEYWORDS_C | KEYWORDS_CPP},
+	[243] = {"static_cast", 11, KEYWORDS_CPP},
+	[245] = {"static_assert", 13, KEYWORDS_C | KEYWORDS_CPP},
+	[248] = {"new", 3, KEYWORDS_CPP},
+	[249] = {"using", 5, KEYWORDS_CPP},
+};
 
-/** Inserts a word into the trie. */
-static void
-keywords_trie_insert (CTrie *obj, gchar *word)
+static inline guint
+keywords_hash (const gchar *word, const gint len)
 {
-	gchar *t = word;
-	CTrie *h = obj;
-	
-	if (!obj || !word || !word[0]) {
-		return;
-	}
-	while (t[0]) {
-		CTrie *n;
-		
-		if (!h->sub[(gint) t[0]]) {
-			n = (CTrie *) g_malloc (sizeof (CTrie));
-			memset (n, 0, sizeof (CTrie));
-		}
-		else {
-			n = h->sub[(gint) t[0]];
-		};
-		h->sub[(gint) t[0]] = n;
-		if (!t[1]) {
-			n->flag = 1;
-		}
-		t++;
-		h = n;
-	}
-}
-
-static gint
-keywords_trie_search (CTrie *obj, gchar *word) {
-	if (!obj || !word || !word[0]) {
-		return 0;
-	}
-	if (!word[1]) {
-		return obj->sub[(guchar) word[0]] && obj->sub[(guchar) word[0]]->flag;
-	}
-	return obj->sub[(guchar) word[0]]? keywords_trie_search(obj->sub[(guchar) word[0]], word + 1): 0;
-}
-
-/*
-static gint
-keywords_trie_starts_with (CTrie* obj, gchar *prefix) {
-	if (!obj || !prefix || !prefix[0]) {
-		return 0;
-	}
-	if (!prefix[1]) {
-		return obj->sub[prefix[0] - 'a'] != NULL;
-	}
-
-	return obj->sub[prefix[0] - 'a']? keywords_trie_starts_with(obj->sub[prefix[0] - 'a'], prefix + 1): 0;
-}
-
-static void
-keywords_trie_free (CTrie* obj) {
-	if (!obj) {
-		return;
-	}
-
-	for (gint i = 0; i < 26; i++) {
-		keywords_trie_free (obj->sub[i]);
-	}
-
-	g_free (obj);
+	return (len + asso[(guchar) word[0]] + asso[(guchar) word[1]] +
+			asso[(guchar) word[len > 4? 4: len - 1]] +
+			asso[(guchar) word[len - 1]]) & (KEYWORDS_TABLE_SIZE - 1);
 }
-*/
 
-void
-keywords_init ()
+/* Check whether the len bytes at word are a keyword of one of dialects. */
+gboolean
+keywords_is_keyword (const gchar *word, const gint len, const gint dialects)
 {
-	gchar **keyword = keywords;
-
-	trie = keywords_trie_create ();
-	if (!trie) {
-		return;
-	}
+	const CKeyword *keyword;
 
-	while (*(keyword++)) {
-		keywords_trie_insert (trie, *keyword);
+	if (len < MIN_KEYWORD_LENGTH || len > MAX_KEYWORD_LENGTH) {
+		return FALSE;
 	}
-}
 
-gint
-keywords_is_keyword (gchar *word)
-{
-	if (!trie) {
-		return 0;
-	}
+	keyword = &keywords[keywords_hash (word, len)];
 
-	return keywords_trie_search (trie, word);
+	return keyword->len == len && (keyword->dialects & dialects) &&
+		   memcmp (keyword->word, word, len) == 0;
 }
@@ -21,12 +21,15 @@
 #ifndef KEYWORDS_H
 #define KEYWORDS_H
 
+#include <gtk/gtk.h>
+
 #define MAX_KEYWORD_LENGTH 16
 
-void
-keywords_init ();
+/* Keyword sets. */
+#define KEYWORDS_C 1
+#define KEYWORDS_CPP 2
 
-gint
-keywords_is_keyword (gchar *word);
+gboolean
+keywords_is_keyword (const gchar *word, const gint len, const gint dialects);
 
 #endif /* KEYWORDS_H */
@@ -0,0 +1,233 @@
+/*
+ * libindex.c
+ * This file is part of codefox
+ *
+ * Copyright (C) 2012-2017 - Gordon Li
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <string.h>
+#include <unistd.h>
+#include <glib/gstdio.h>
+
+#include "libindex.h"
+#include "env.h"
+
+/* Headers of the C library, not their subdirectories. */
+#define LIBINDEX_SYSTEM_DIR "/usr/include"
+
+/* Output of argv, NULL if it could not run or failed. */
+static gchar *
+libindex_run (gchar **argv)
+{
+	gchar *output;
+	gint status;
+
+	output = NULL;
+	if (!g_spawn_sync (NULL, argv, NULL,
+					   G_SPAWN_SEARCH_PATH | G_SPAWN_STDERR_TO_DEV_NULL,
+					   NULL, NULL, &output, NULL, &status, NULL)) {
+		return NULL;
+	}
+	if (status != 0) {
+		g_free ((gpointer) output);
+
+		return NULL;
+	}
+
+	return output;
+}
+
+/* Maps the tags of one entry of the cache, running ctags over dirs into
+ * it first if this version of the entry is not there yet.
+ */
+static GMappedFile *
+libindex_entry (const gchar *name, const gchar *version, gchar **dirs, const gboolean recurse)
+{
+	GMappedFile *map;
+	GPtrArray *argv;
+	gchar *cache_dir;
+	gchar *filename;
+	gchar *path;
+	gchar *tmp_path;
+	gchar *output;
+	gint i;
+
+	cache_dir = g_build_filename (g_get_user_cache_dir (), "codefox", "libindex", NULL);
+	g_mkdir_with_parents (cache_dir, 0755);
+	filename = g_strdup_printf ("%s-%s.tags", name, version);
+	g_strdelimit (filename, G_DIR_SEPARATOR_S, '_');
+	path = g_build_filename (cache_dir, filename, NULL);
+	g_free ((gpointer) filename);
+	g_free ((gpointer) cache_dir);
+
+	map = g_mapped_file_new (path, FALSE, NULL);
+	if (map != NULL) {
+		g_free ((gpointer) path);
+
+		return map;
+	}
+
+	/* Written aside and renamed, another instance may read it meanwhile. */
+	tmp_path = g_strdup_printf ("%s.%d", path, (gint) getpid ());
+	argv = g_ptr_array_new ();
+	g_ptr_array_add (argv, "ctags");
+	g_ptr_array_add (argv, "-f");
+	g_ptr_array_add (argv, tmp_path);
+	g_ptr_array_add (argv, "--fields=ksStan");
+	g_ptr_array_add (argv, "--c-kinds=+p");
+	g_ptr_array_add (argv, "--c++-kinds=+p");
+	if (recurse) {
+		g_ptr_array_add (argv, "-R");
+	}
+	for (i = 0; dirs[i]; i++) {
+		g_ptr_array_add (argv, dirs[i]);
+	}
+	g_ptr_array_add (argv, NULL);
+
+	output = libindex_run ((gchar **) argv->pdata);
+	g_ptr_array_free (argv, TRUE);
+
+	if (output != NULL && g_rename (tmp_path, path) == 0) {
+		map = g_mapped_file_new (path, FALSE, NULL);
+	}
+	else {
+		g_warning ("failed to index headers of %s.", name);
+		g_unlink (tmp_path);
+	}
+
+	g_free ((gpointer) output);
+	g_free ((gpointer) tmp_path);
+	g_free ((gpointer) path);
+
+	return map;
+}
+
+/* The C library entry goes by the time its directory last changed. */
+static GMappedFile *
+libindex_system ()
+{
+	gchar *dirs[] = { LIBINDEX_SYSTEM_DIR, NULL };
+	GStatBuf st;
+	gchar *version;
+	GMappedFile *map;
+
+	if (g_stat (LIBINDEX_SYSTEM_DIR, &st) != 0) {
+		return NULL;
+	}
+
+	version = g_strdup_printf ("%" G_GINT64_FORMAT, (gint64) st.st_mtime);
+	map = libindex_entry ("system", version, dirs, FALSE);
+	g_free ((gpointer) version);
+
+	return map;
+}
+
+/* A pkg-config package goes by its version and covers the directories
+ * of its -I flags.
+ */
+static GMappedFile *
+libindex_package (const gchar *package)
+{
+	gchar *argv[4];
+	gchar *version;
+	gchar *cflags;
+	gchar **flags;
+	GPtrArray *dirs;
+	GMappedFile *map;
+	gint i;
+
+	argv[0] = "pkg-config";
+	argv[1] = "--modversion";
+	argv[2] = (gchar *) package;
+	argv[3] = NULL;
+	version = libindex_run (argv);
+	if (version == NULL) {
+		return NULL;
+	}
+	g_strstrip (version);
+
+	argv[1] = "--cflags-only-I";
+	cflags = libindex_run (argv);
+	if (cflags == NULL) {
+		g_free ((gpointer) version);
+
+		return NULL;
+	}
+
+	flags = g_strsplit_set (g_strstrip (cflags), " \t\n", -1);
+	dirs = g_ptr_array_new ();
+	for (i = 0; flags[i]; i++) {
+		if (g_str_has_prefix (flags[i], "-I") && flags[i][2] != 0) {
+			g_ptr_array_add (dirs, flags[i] + 2);
+		}
+	}
+	g_ptr_array_add (dirs, NULL);
+
+	map = NULL;
+	if (dirs->len > 1) {
+		map = libindex_entry (package, version, (gchar **) dirs->pdata, TRUE);
+	}
+
+	g_ptr_array_free (dirs, TRUE);
+	g_strfreev (flags);
+	g_free ((gpointer) cflags);
+	g_free ((gpointer) version);
+
+	return map;
+}
+
+/* Maps the tags of the C library and of every pkg-config package named in
+ * libs from the per user cache, indexing what is missing or outdated
+ * first. The cache is shared by all projects. This may run ctags over
+ * large trees, so it is for worker threads only.
+ */
+GList *
+libindex_load (const gchar *libs)
+{
+	GList *maps;
+	GMappedFile *map;
+	gchar **packages;
+	gint i;
+
+	maps = NULL;
+	if (!env_prog_exist (ENV_PROG_CTAGS)) {
+		return NULL;
+	}
+
+	map = libindex_system ();
+	if (map != NULL) {
+		maps = g_list_prepend (maps, map);
+	}
+
+	if (libs == NULL || !env_prog_exist (ENV_PROG_PKG_CONFIG)) {
+		return g_list_reverse (maps);
+	}
+
+	packages = g_strsplit_set (libs, " \t", -1);
+	for (i = 0; packages[i]; i++) {
+		if (packages[i][0] == 0) {
+			continue;
+		}
+
+		map = libindex_package (packages[i]);
+		if (map != NULL) {
+			maps = g_list_prepend (maps, map);
+		}
+	}
+	g_strfreev (packages);
+
+	return g_list_reverse (maps);
+}
@@ -0,0 +1,385 @@
+/*
+ * localdecl.c
+ * This file is part of codefox
+ *
+ * Copyright (C) 2012-2017 - Gordon Li
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <gtk/gtk.h>
+#include <string.h>
+
+#include "localdecl.h"
+#include "keywords.h"
+#include "project.h"
+
+#define IDENT_START(c) ((c >= 'a' && c <= 'z') || (c >= 'A' && c <= 'Z') || c == '_')
+
+#define IDENT(c) (IDENT_START (c) || (c >= '0' && c <= '9'))
+
+typedef struct {
+	gchar *name;
+	gchar *type;
+	gboolean isptr;
+} CLocalDecl;
+
+static void
+localdecl_decl_clear (gpointer data)
+{
+	CLocalDecl *decl = (CLocalDecl *) data;
+
+	g_free ((gpointer) decl->name);
+	g_free ((gpointer) decl->type);
+}
+
+static void
+localdecl_line_free (gpointer data)
+{
+	if (data != NULL) {
+		g_array_free ((GArray *) data, TRUE);
+	}
+}
+
+static gint
+localdecl_dialects ()
+{
+	if (project_current_path () == NULL) {
+		return KEYWORDS_C | KEYWORDS_CPP;
+	}
+
+	return project_get_type () == PROJECT_C? KEYWORDS_C: KEYWORDS_C | KEYWORDS_CPP;
+}
+
+static void
+localdecl_add (GArray *decls, const gchar *name, const gint name_len,
+			   const gchar *type, const gint type_len, const gboolean isptr)
+{
+	CLocalDecl decl;
+
+	decl.name = g_strndup (name, name_len);
+	decl.type = g_strndup (type, type_len);
+	decl.isptr = isptr;
+	g_array_append_val (decls, decl);
+}
+
+/* Finds "Type name", "Type *name" and "Type a, *b" in one line. A pair
+ * whose first word is a keyword is no declaration of anything that has
+ * members, so base types, return and the like drop out here.
+ */
+static GArray *
+localdecl_scan (const gchar *line, const gint dialects)
+{
+	GArray *decls;
+	const gchar *type;
+	gint type_len;
+	const gchar *list_type;
+	gint list_len;
+	const gchar *last_word;
+	gint last_len;
+	gboolean from_list;
+	gboolean isptr;
+	gint depth;
+	const gchar *p;
+
+	decls = g_array_new (FALSE, FALSE, sizeof (CLocalDecl));
+	g_array_set_clear_func (decls, localdecl_decl_clear);
+
+	p = line;
+	while (*p == ' ' || *p == '\t') {
+		p++;
+	}
+	if (*p == '#') {
+		return decls;
+	}
+
+	type = NULL;
+	type_len = 0;
+	list_type = NULL;
+	list_len = 0;
+	last_word = NULL;
+	last_len = 0;
+	from_list = FALSE;
+	isptr = FALSE;
+	while (*p) {
+		if (IDENT_START (*p)) {
+			const gchar *word;
+			gint len;
+			gboolean keyword;
+
+			word = p;
+			while (IDENT (*p)) {
+				p++;
+			}
+			len = p - word;
+			keyword = len <= MAX_KEYWORD_LENGTH && keywords_is_keyword (word, len, dialects);
+
+			/* "f (Foo *a, Bar b)": the word taken for a second name of
+			 * Foo was the type of a new declaration.
+			 */
+			if (from_list) {
+				g_array_remove_index (decls, decls->len - 1);
+				type = last_word;
+				type_len = last_len;
+				from_list = FALSE;
+			}
+
+			if (type != NULL) {
+				localdecl_add (decls, word, len, type, type_len, isptr);
+
+				list_type = type;
+				list_len = type_len;
+				type = NULL;
+			}
+			else if (list_type != NULL && !keyword) {
+				localdecl_add (decls, word, len, list_type, list_len, isptr);
+
+				from_list = TRUE;
+				last_word = word;
+				last_len = len;
+			}
+			else {
+				if (!keyword) {
+					type = word;
+					type_len = len;
+				}
+				list_type = NULL;
+			}
+			isptr = FALSE;
+
+			continue;
+		}
+
+		switch (*p) {
+		case ' ':
+		case '\t':
+		case '&':
+			break;
+		case '*':
+			isptr = TRUE;
+			break;
+		case ',':
+			/* "Type a, *b": the next name has the same type. */
+			type = NULL;
+			from_list = FALSE;
+			isptr = FALSE;
+			break;
+		case '=':
+		case '[':
+			/* Skip the initializer or size up to the next declarator. */
+			depth = 0;
+			for (; *p; p++) {
+				if (*p == '(' || *p == '[' || *p == '{') {
+					depth++;
+				}
+				else if (*p == ')' || *p == ']' || *p == '}') {
+					if (depth == 0) {
+						break;
+					}
+					depth--;
+				}
+				else if ((*p == ',' || *p == ';') && depth == 0) {
+					break;
+				}
+			}
+			type = NULL;
+			from_list = FALSE;
+			continue;
+		case '"':
+		case '\'':
+			{
+				gchar quote = *p;
+
+				for (p++; *p && *p != quote; p++) {
+					if (*p == '\\' && p[1]) {
+						p++;
+					}
+				}
+				if (!*p) {
+					return decls;
+				}
+			}
+			type = NULL;
+			list_type = NULL;
+			from_list = FALSE;
+			break;
+		case '/':
+			if (p[1] == '/') {
+				return decls;
+			}
+			/* Fall through. */
+		default:
+			type = NULL;
+			list_type = NULL;
+			from_list = FALSE;
+			isptr = FALSE;
+			break;
+		}
+		p++;
+	}
+
+	return decls;
+}
+
+static void
+localdecl_insert_lines (CLocalIndex *index, const gint line, const gint count)
+{
+	guint old_len;
+
+	old_len = index->lines->len;
+	g_ptr_array_set_size (index->lines, old_len + count);
+	memmove (index->lines->pdata + line + 1 + count, index->lines->pdata + line + 1,
+			 (old_len - line - 1) * sizeof (gpointer));
+	memset (index->lines->pdata + line + 1, 0, count * sizeof (gpointer));
+}
+
+static void
+localdecl_invalidate (CLocalIndex *index, const gint line)
+{
+	if (line < (gint) index->lines->len && index->lines->pdata[line] != NULL) {
+		localdecl_line_free (index->lines->pdata[line]);
+		index->lines->pdata[line] = NULL;
+	}
+}
+
+static void
+on_localdecl_insert (GtkTextBuffer *buffer, GtkTextIter *location, gchar *text,
+					 gint len, gpointer user_data)
+{
+	CLocalIndex *index = (CLocalIndex *) user_data;
+	const gchar *p;
+	gint line;
+	gint count;
+
+	line = gtk_text_iter_get_line (location);
+	localdecl_invalidate (index, line);
+
+	count = 0;
+	for (p = text; (p = memchr (p, '\n', text + len - p)) != NULL; p++) {
+		count++;
+	}
+	if (count > 0 && line < (gint) index->lines->len) {
+		localdecl_insert_lines (index, line, count);
+	}
+}
+
+static void
+on_localdecl_delete (GtkTextBuffer *buffer, GtkTextIter *start, GtkTextIter *end,
+					 gpointer user_data)
+{
+	CLocalIndex *index = (CLocalIndex *) user_data;
+	gint start_line;
+	gint end_line;
+
+	start_line = gtk_text_iter_get_line (start);
+	end_line = gtk_text_iter_get_line (end);
+
+	localdecl_invalidate (index, start_line);
+	if (end_line > start_line && end_line < (gint) index->lines->len) {
+		g_ptr_array_remove_range (index->lines, start_line + 1, end_line - start_line);
+	}
+}
+
+CLocalIndex *
+localdecl_new (GtkTextBuffer *buffer)
+{
+	CLocalIndex *index;
+
+	index = (CLocalIndex *) g_malloc (sizeof (CLocalIndex));
+	index->buffer = buffer;
+	index->lines = g_ptr_array_new_with_free_func (localdecl_line_free);
+	g_ptr_array_set_size (index->lines, gtk_text_buffer_get_line_count (buffer));
+	index->dialects = localdecl_dialects ();
+
+	/* Before the default handlers, while the iters still see the old text. */
+	index->insert_id = g_signal_connect (buffer, "insert-text",
+										 G_CALLBACK (on_localdecl_insert), index);
+	index->delete_id = g_signal_connect (buffer, "delete-range",
+										 G_CALLBACK (on_localdecl_delete), index);
+
+	return index;
+}
+
+void
+localdecl_free (CLocalIndex *index)
+{
+	if (index == NULL) {
+		return;
+	}
+
+	g_signal_handler_disconnect (index->buffer, index->insert_id);
+	g_signal_handler_disconnect (index->buffer, index->delete_id);
+	g_ptr_array_free (index->lines, TRUE);
+	g_free ((gpointer) index);
+}
+
+static GArray *
+localdecl_line (CLocalIndex *index, const gint line)
+{
+	GtkTextIter start;
+	GtkTextIter end;
+	gchar *text;
+
+	if (index->lines->pdata[line] == NULL) {
+		gtk_text_buffer_get_iter_at_line (index->buffer, &start, line);
+		end = start;
+		if (!gtk_text_iter_ends_line (&end)) {
+			gtk_text_iter_forward_to_line_end (&end);
+		}
+		text = gtk_text_buffer_get_text (index->buffer, &start, &end, FALSE);
+		index->lines->pdata[line] = localdecl_scan (text, index->dialects);
+		g_free ((gpointer) text);
+	}
+
+	return (GArray *) index->lines->pdata[line];
+}
+
+/* Type of the nearest declaration of name up to line lineno (1-based)
+ * with the same pointer level as the access, in type.
+ */
+gboolean
+localdecl_find_type (CLocalIndex *index, const gchar *name, const gint lineno,
+					 const gboolean isptr, gchar *type, const gint size)
+{
+	gint line;
+
+	type[0] = 0;
+	if (index == NULL) {
+		return FALSE;
+	}
+
+	/* The line array follows the buffer, but never trust it blindly. */
+	if ((gint) index->lines->len != gtk_text_buffer_get_line_count (index->buffer)) {
+		g_ptr_array_set_size (index->lines, 0);
+		g_ptr_array_set_size (index->lines, gtk_text_buffer_get_line_count (index->buffer));
+	}
+
+	for (line = MIN (lineno, (gint) index->lines->len) - 1; line >= 0; line--) {
+		GArray *decls;
+		gint i;
+
+		decls = localdecl_line (index, line);
+		for (i = decls->len - 1; i >= 0; i--) {
+			CLocalDecl *decl = &g_array_index (decls, CLocalDecl, i);
+
+			if (decl->isptr == isptr && g_strcmp0 (decl->name, name) == 0) {
+				g_strlcpy (type, decl->type, size);
+
+				return TRUE;
+			}
+		}
+	}
+
+	return FALSE;
+}
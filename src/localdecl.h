@@ -0,0 +1,48 @@
+/*
+ * localdecl.h
+ * This file is part of codefox
+ *
+ * Copyright (C) 2012-2017 - Gordon Li
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef LOCALDECL_H
+#define LOCALDECL_H
+
+#include <gtk/gtk.h>
+
+/* Declarations of locals and parameters in one buffer, per line. Lines
+ * are rescanned lazily after they are edited, the rest stay valid as
+ * text is inserted and deleted around them.
+ */
+typedef struct {
+	GtkTextBuffer *buffer;
+	GPtrArray *lines;
+	gint dialects;
+	gulong insert_id;
+	gulong delete_id;
+} CLocalIndex;
+
+CLocalIndex *
+localdecl_new (GtkTextBuffer *buffer);
+
+void
+localdecl_free (CLocalIndex *index);
+
+gboolean
+localdecl_find_type (CLocalIndex *index, const gchar *name, const gint lineno,
+					 const gboolean isptr, gchar *type, const gint size);
+
+#endif /* LOCALDECL_H */
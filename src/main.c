@@ -27,13 +27,13 @@
 #include <glib/gi18n-lib.h>
 
 #include "ui.h"
-#include "staticcheck.h"
 #include "symbol.h"
 #include "prefix.h"
 #include "project.h"
 #include "search.h"
 #include "highlighting.h"
 #include "env.h"
+#include "incgraph.h"
 
 gboolean
 timer(gpointer data)
@@ -44,10 +44,6 @@ timer(gpointer data)
 	if (!ret) {
 		g_warning ("something wrong in highlighting timmer.");
 	}
-	ret = static_check (NULL);
-	if (!ret) {
-		g_warning ("something wrong in static checking timmer.");
-	}
 	ret = symbol_parse (NULL);
 	if (!ret) {
 		g_warning ("something wrong in symbol parsing timmer.");
@@ -70,6 +66,7 @@ modules_init ()
 	highlight_init ();
 	env_init ();
 	ui_init ();
+	incgraph_init ();
 	symbol_init ();
 }
 
@@ -0,0 +1,399 @@
+/*
+ * spancache.c
+ * This file is part of codefox
+ *
+ * Copyright (C) 2012-2017 - Gordon Li
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <string.h>
+#include <glib/gstdio.h>
+
+#include "spancache.h"
+#include "editorconfig.h"
+
+/* Files whose spans are kept in memory, and the memory they may take. */
+#define SPANCACHE_MAX_ENTRIES 32
+#define SPANCACHE_MAX_BYTES (64 << 20)
+
+/* "CFSC" */
+#define SPANCACHE_MAGIC 0x43534643
+#define SPANCACHE_VERSION 1
+
+#define SPANCACHE_DIR_MODE 0755
+
+/* Layout of a cache file, followed by states and spans. */
+typedef struct {
+	guint32 magic;
+	guint32 version;
+	guint64 hash;
+	gint32 dialects;
+	gint32 chars;
+	guint32 states;
+	guint32 spans;
+} CSpanCacheHeader;
+
+/* Most recently used entries first, and the queue link of every file. */
+static GQueue spancache_lru = G_QUEUE_INIT;
+static GHashTable *spancache_index;
+static gsize spancache_bytes;
+
+/* Writers trim the disk cache one at a time. */
+static GMutex spancache_disk_mutex;
+
+void
+spancache_init ()
+{
+	spancache_index = g_hash_table_new (g_str_hash, g_str_equal);
+}
+
+/* A fast non-cryptographic hash of file content, eight bytes at a time. */
+guint64
+spancache_hash (const gchar *text, const gsize len)
+{
+	guint64 hash;
+	guint64 word;
+	gsize i;
+
+	hash = 0xcbf29ce484222325ULL ^ len;
+	for (i = 0; i + 8 <= len; i += 8) {
+		memcpy (&word, text + i, 8);
+		hash = (hash ^ word) * 0x100000001b3ULL;
+		hash ^= hash >> 29;
+	}
+
+	word = 0;
+	memcpy (&word, text + i, len - i);
+	hash = (hash ^ word) * 0x100000001b3ULL;
+	hash ^= hash >> 32;
+
+	return hash;
+}
+
+static gsize
+spancache_entry_size (const CSpanCacheEntry *entry)
+{
+	return entry->states->len + entry->spans->len * sizeof (CHighlightSpan);
+}
+
+static void
+spancache_entry_free (CSpanCacheEntry *entry)
+{
+	g_free ((gpointer) entry->filepath);
+	g_array_free (entry->states, TRUE);
+	g_array_free (entry->spans, TRUE);
+	g_free ((gpointer) entry);
+}
+
+static void
+spancache_remove (GList *link)
+{
+	CSpanCacheEntry *entry;
+
+	entry = (CSpanCacheEntry *) link->data;
+	g_hash_table_remove (spancache_index, entry->filepath);
+	g_queue_delete_link (&spancache_lru, link);
+	spancache_bytes -= spancache_entry_size (entry);
+	spancache_entry_free (entry);
+}
+
+static void
+spancache_insert (CSpanCacheEntry *entry)
+{
+	GList *link;
+
+	link = (GList *) g_hash_table_lookup (spancache_index, entry->filepath);
+	if (link != NULL) {
+		spancache_remove (link);
+	}
+
+	g_queue_push_head (&spancache_lru, (gpointer) entry);
+	g_hash_table_insert (spancache_index, entry->filepath, spancache_lru.head);
+	spancache_bytes += spancache_entry_size (entry);
+
+	/* The newest entry stays even if it is over the limit alone. */
+	while (spancache_lru.length > 1 &&
+		   (spancache_lru.length > SPANCACHE_MAX_ENTRIES || spancache_bytes > SPANCACHE_MAX_BYTES)) {
+		spancache_remove (spancache_lru.tail);
+	}
+}
+
+/* The bytes the disk cache may take, 0 if it is turned off. */
+static gint64
+spancache_disk_size ()
+{
+	const CEditorConfig *editor_config;
+
+	editor_config = editorconfig_config_get ();
+
+	return editor_config != NULL? editor_config->span_cache_size: 0;
+}
+
+static gchar *
+spancache_disk_dir ()
+{
+	return g_build_filename (g_get_user_cache_dir (), "codefox", "spans", NULL);
+}
+
+static gchar *
+spancache_disk_path (const gchar *filepath)
+{
+	/* Spans can also be cached on disk, in the per user cache. */
+	gchar *dir;
+	gchar *name;
+	gchar *path;
+
+	if (spancache_disk_size () <= 0) {
+		return NULL;
+	}
+
+	dir = spancache_disk_dir ();
+	name = g_compute_checksum_for_string (G_CHECKSUM_SHA1, filepath, -1);
+	path = g_build_filename (dir, name, NULL);
+	g_free ((gpointer) name);
+	g_free ((gpointer) dir);
+
+	return path;
+}
+
+typedef struct {
+	gchar *path;
+	gint64 mtime;
+	gint64 size;
+} CSpanCacheFile;
+
+static gint
+spancache_file_compare (gconstpointer a, gconstpointer b)
+{
+	const CSpanCacheFile *fa = (const CSpanCacheFile *) a;
+	const CSpanCacheFile *fb = (const CSpanCacheFile *) b;
+
+	return fa->mtime < fb->mtime? -1: fa->mtime > fb->mtime;
+}
+
+/* Removes the least recently written files of dir until it holds no more
+ * than max_size bytes.
+ */
+static void
+spancache_disk_trim (const gchar *dir, const gint64 max_size)
+{
+	GDir *handle;
+	GArray *files;
+	const gchar *name;
+	gint64 total;
+	guint i;
+
+	handle = g_dir_open (dir, 0, NULL);
+	if (handle == NULL) {
+		return;
+	}
+
+	files = g_array_new (FALSE, FALSE, sizeof (CSpanCacheFile));
+	total = 0;
+	while ((name = g_dir_read_name (handle)) != NULL) {
+		CSpanCacheFile file;
+		GStatBuf st;
+
+		file.path = g_build_filename (dir, name, NULL);
+		if (g_stat (file.path, &st) != 0) {
+			g_free ((gpointer) file.path);
+			continue;
+		}
+		file.mtime = st.st_mtime;
+		file.size = st.st_size;
+		total += file.size;
+		g_array_append_val (files, file);
+	}
+	g_dir_close (handle);
+
+	g_array_sort (files, spancache_file_compare);
+	for (i = 0; i < files->len; i++) {
+		CSpanCacheFile *file = &g_array_index (files, CSpanCacheFile, i);
+
+		if (total > max_size && g_unlink (file->path) == 0) {
+			total -= file->size;
+		}
+		g_free ((gpointer) file->path);
+	}
+	g_array_free (files, TRUE);
+}
+
+static CSpanCacheEntry *
+spancache_disk_load (const gchar *filepath, const guint64 hash, const gint dialects)
+{
+	CSpanCacheEntry *entry;
+	CSpanCacheHeader header;
+	gchar *path;
+	gchar *content;
+	gsize len;
+
+	path = spancache_disk_path (filepath);
+	if (path == NULL) {
+		return NULL;
+	}
+
+	if (!g_file_get_contents (path, &content, &len, NULL)) {
+		g_free ((gpointer) path);
+
+		return NULL;
+	}
+	g_free ((gpointer) path);
+
+	entry = NULL;
+	if (len >= sizeof (CSpanCacheHeader)) {
+		memcpy (&header, content, sizeof (CSpanCacheHeader));
+	}
+	if (len >= sizeof (CSpanCacheHeader) && header.magic == SPANCACHE_MAGIC &&
+		header.version == SPANCACHE_VERSION && header.hash == hash &&
+		header.dialects == dialects &&
+		len == sizeof (CSpanCacheHeader) + header.states +
+			   (gsize) header.spans * sizeof (CHighlightSpan)) {
+		entry = (CSpanCacheEntry *) g_malloc (sizeof (CSpanCacheEntry));
+		entry->filepath = g_strdup (filepath);
+		entry->hash = hash;
+		entry->dialects = dialects;
+		entry->chars = header.chars;
+		entry->states = g_array_sized_new (FALSE, FALSE, sizeof (guint8), header.states);
+		g_array_append_vals (entry->states, content + sizeof (CSpanCacheHeader), header.states);
+		entry->spans = g_array_sized_new (FALSE, FALSE, sizeof (CHighlightSpan), header.spans);
+		g_array_append_vals (entry->spans, content + sizeof (CSpanCacheHeader) + header.states,
+							 header.spans);
+	}
+
+	g_free ((gpointer) content);
+
+	return entry;
+}
+
+typedef struct {
+	GByteArray *file;
+	gint64 max_size;
+} CSpanCacheWrite;
+
+static gpointer
+spancache_disk_write (gpointer data)
+{
+	/* The file is the path to write to, the content follows its nul. */
+	CSpanCacheWrite *job;
+	const gchar *path;
+	gsize offset;
+	gchar *dir;
+
+	job = (CSpanCacheWrite *) data;
+	path = (const gchar *) job->file->data;
+	offset = strlen (path) + 1;
+
+	dir = g_path_get_dirname (path);
+	g_mutex_lock (&spancache_disk_mutex);
+	if (job->file->len - offset <= (gsize) job->max_size &&
+		g_mkdir_with_parents (dir, SPANCACHE_DIR_MODE) == 0 &&
+		g_file_set_contents (path, (const gchar *) job->file->data + offset,
+							 job->file->len - offset, NULL)) {
+		spancache_disk_trim (dir, job->max_size);
+	}
+	g_mutex_unlock (&spancache_disk_mutex);
+
+	g_free ((gpointer) dir);
+	g_byte_array_free (job->file, TRUE);
+	g_free ((gpointer) job);
+
+	return NULL;
+}
+
+static void
+spancache_disk_store (const CSpanCacheEntry *entry)
+{
+	CSpanCacheHeader header;
+	CSpanCacheWrite *job;
+	GByteArray *file;
+	gchar *path;
+
+	path = spancache_disk_path (entry->filepath);
+	if (path == NULL) {
+		return;
+	}
+
+	memset (&header, 0, sizeof (CSpanCacheHeader));
+	header.magic = SPANCACHE_MAGIC;
+	header.version = SPANCACHE_VERSION;
+	header.hash = entry->hash;
+	header.dialects = entry->dialects;
+	header.chars = entry->chars;
+	header.states = entry->states->len;
+	header.spans = entry->spans->len;
+
+	file = g_byte_array_sized_new (strlen (path) + 1 + sizeof (CSpanCacheHeader) +
+								   spancache_entry_size (entry));
+	g_byte_array_append (file, (const guint8 *) path, strlen (path) + 1);
+	g_byte_array_append (file, (const guint8 *) &header, sizeof (CSpanCacheHeader));
+	g_byte_array_append (file, (const guint8 *) entry->states->data, entry->states->len);
+	g_byte_array_append (file, (const guint8 *) entry->spans->data,
+						 entry->spans->len * sizeof (CHighlightSpan));
+	g_free ((gpointer) path);
+
+	job = (CSpanCacheWrite *) g_malloc (sizeof (CSpanCacheWrite));
+	job->file = file;
+	job->max_size = spancache_disk_size ();
+	g_thread_unref (g_thread_new ("spancache", spancache_disk_write, (gpointer) job));
+}
+
+/* Spans of filepath if they were stored for the same content and keyword
+ * sets, from memory or else from the disk cache. The entry is only
+ * valid until the next store.
+ */
+const CSpanCacheEntry *
+spancache_lookup (const gchar *filepath, const guint64 hash, const gint dialects)
+{
+	CSpanCacheEntry *entry;
+	GList *link;
+
+	link = (GList *) g_hash_table_lookup (spancache_index, filepath);
+	if (link != NULL) {
+		entry = (CSpanCacheEntry *) link->data;
+		if (entry->hash == hash && entry->dialects == dialects) {
+			g_queue_unlink (&spancache_lru, link);
+			g_queue_push_head_link (&spancache_lru, link);
+
+			return entry;
+		}
+	}
+
+	entry = spancache_disk_load (filepath, hash, dialects);
+	if (entry != NULL) {
+		spancache_insert (entry);
+	}
+
+	return entry;
+}
+
+void
+spancache_store (const gchar *filepath, const guint64 hash, const gint dialects,
+				 GArray *states, GArray *spans, const gint chars)
+{
+	CSpanCacheEntry *entry;
+
+	entry = (CSpanCacheEntry *) g_malloc (sizeof (CSpanCacheEntry));
+	entry->filepath = g_strdup (filepath);
+	entry->hash = hash;
+	entry->dialects = dialects;
+	entry->chars = chars;
+	entry->states = g_array_sized_new (FALSE, FALSE, sizeof (guint8), states->len);
+	g_array_append_vals (entry->states, states->data, states->len);
+	entry->spans = g_array_sized_new (FALSE, FALSE, sizeof (CHighlightSpan), spans->len);
+	g_array_append_vals (entry->spans, spans->data, spans->len);
+
+	spancache_insert (entry);
+	spancache_disk_store (entry);
+}
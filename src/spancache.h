@@ -0,0 +1,52 @@
+/*
+ * spancache.h
+ * This file is part of codefox
+ *
+ * Copyright (C) 2012-2017 - Gordon Li
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef SPANCACHE_H
+#define SPANCACHE_H
+
+#include <gtk/gtk.h>
+#include "highlighting.h"
+
+/* Highlighting result of a whole file: the lexer state at the start of
+ * every line and the spans in char offsets from the start of the file.
+ */
+typedef struct {
+	gchar *filepath;
+	guint64 hash;
+	gint dialects;
+	gint chars;
+	GArray *states;
+	GArray *spans;
+} CSpanCacheEntry;
+
+void
+spancache_init ();
+
+guint64
+spancache_hash (const gchar *text, const gsize len);
+
+const CSpanCacheEntry *
+spancache_lookup (const gchar *filepath, const guint64 hash, const gint dialects);
+
+void
+spancache_store (const gchar *filepath, const guint64 hash, const gint dialects,
+				 GArray *states, GArray *spans, const gint chars);
+
+#endif /* SPANCACHE_H */
@@ -24,69 +24,160 @@
 #include "misc.h"
 #include "ui.h"
 #include "project.h"
+#include "editorconfig.h"
+#include "incgraph.h"
 #include "env.h"
 #include "limits.h"
 
 extern CWindow *window;
 
-gboolean 
-static_check (gpointer data)
-{	
-	/* Get current code and check for errors and warnings. */
-	gchar *output;
-	gchar line[MAX_FILEPATH_LENGTH + 1];
+/* Slow checks push the next one back by up to this many milliseconds. */
+#define STATIC_CHECK_MAX_DELAY 5000
+
+/* Bumped on every edit, a check only counts for the revision it began on. */
+static gint static_generation;
+static gboolean static_running;
+
+/* The pending check, and the content of the last one that was applied. */
+static guint static_source;
+static guint64 static_last_hash;
+static gchar *static_last_path;
+static gint static_last_elapsed;
+
+/* The compilers are probed once at startup, so say one is missing only once. */
+static gboolean static_gcc_warned;
+static gboolean static_gpp_warned;
+
+typedef struct {
+	gint generation;
+	guint64 hash;
+	gint64 start;
+	gint type;
 	gchar *code;
-	gchar *project_path;
-	gchar file_path[MAX_FILEPATH_LENGTH + 1];
-	gchar code_path[MAX_FILEPATH_LENGTH + 1];
-	gint project_type;
-	gchar libs[MAX_LINE_LENGTH + 1];
-	gint p;
-	gboolean error;
-	gboolean warning;
+	gchar *code_path;
+	gchar *file_path;
+	gchar *libs;
+	gchar *output;
+} CStaticJob;
 
-	project_path = NULL;
+/* FNV-1a over the buffer, only used to spot an unchanged buffer. */
+static guint64
+static_check_hash (const gchar *code)
+{
+	guint64 hash;
 
-	if (!ui_have_editor ()) {
-		return TRUE;
+	hash = 0xcbf29ce484222325ULL;
+	while (*code != 0) {
+		hash = (hash ^ (guchar) *code) * 0x100000001b3ULL;
+		code++;
 	}
 
-	ui_current_editor_filepath (file_path);
-	if (project_path == NULL) {
-		project_path = project_current_path ();
+	return hash;
+}
+
+static void
+static_job_free (CStaticJob *job)
+{
+	g_free ((gpointer) job->code);
+	g_free ((gpointer) job->code_path);
+	g_free ((gpointer) job->file_path);
+	g_free ((gpointer) job->libs);
+	g_free ((gpointer) job->output);
+	g_free ((gpointer) job);
+}
+
+/* Checks the current buffer once the user has paused for the configured
+ * delay, or for twice as long as the last check took if that is longer.
+ */
+void
+static_check_schedule ()
+{
+	const CEditorConfig *editor_config;
+	gint delay;
+
+	editor_config = editorconfig_config_get ();
+	delay = MAX (editor_config->static_check_delay,
+				 MIN (2 * static_last_elapsed, STATIC_CHECK_MAX_DELAY));
+
+	if (static_source != 0) {
+		g_source_remove (static_source);
 	}
+	static_source = g_timeout_add (delay, static_check, NULL);
+}
 
-	if (project_path == NULL || file_path[0] == 0) {
-		return TRUE;
+/* Marks the buffer as edited, a check that is running for an older
+ * revision is ended and its result dropped.
+ */
+void
+static_check_invalidate ()
+{
+	g_atomic_int_inc (&static_generation);
+	if (static_running) {
+		compile_static_cancel ();
 	}
-	if (project_get_type () == PROJECT_C && !env_prog_exist (ENV_PROG_GCC)) {
-		g_warning ("gcc not found.");
 
-		return FALSE;
+	static_check_schedule ();
+}
+
+/* New project libs or options change the result of the same buffer. */
+void
+static_check_reset ()
+{
+	static_last_hash = 0;
+	static_check_schedule ();
+}
+
+/* A saved header changes the result for the files including it even if
+ * their buffers stay the same.
+ */
+void
+static_check_saved (const gchar *filepath)
+{
+	GList *dependents;
+
+	if (static_last_path == NULL) {
+		return;
 	}
-	if (project_get_type () == PROJECT_CPP && !env_prog_exist (ENV_PROG_GPP)) {
-		g_warning ("g++ not found.");
 
-		return FALSE;
+	dependents = incgraph_dependents (filepath);
+	if (g_list_find_custom (dependents, static_last_path, (GCompareFunc) g_strcmp0) != NULL) {
+		static_last_hash = 0;
+		static_check_schedule ();
 	}
+	g_list_free_full (dependents, g_free);
+}
 
-	project_type = project_get_type ();
-	project_get_settings (libs, MAX_LINE_LENGTH, NULL, 0);
-	g_snprintf (code_path, MAX_LINE_LENGTH, "%s/.static.%s",
-				project_path, project_type? "cpp": "c");
+static gboolean
+static_check_apply (gpointer data)
+{
+	CStaticJob *job = (CStaticJob *) data;
+	gchar line[MAX_FILEPATH_LENGTH + 1];
+	gchar file_path[MAX_FILEPATH_LENGTH + 1];
+	gchar *output;
+	gint p;
+	gboolean error;
+	gboolean warning;
 
-	code = ui_current_editor_code ();
-	if (code == NULL) {
-		return TRUE;
-	}
+	static_running = FALSE;
 
-	misc_set_file_content (code_path, code);
+	/* The buffer changed or another one is shown meanwhile. */
+	file_path[0] = 0;
+	if (ui_have_editor ()) {
+		ui_current_editor_filepath (file_path);
+	}
+	if (job->generation != g_atomic_int_get (&static_generation) ||
+		g_strcmp0 (job->file_path, file_path) != 0) {
+		static_job_free (job);
 
-	g_free ((gpointer) code);
+		return FALSE;
+	}
 
-	output = (gchar *) g_malloc (MAX_RESULT_LENGTH + 1);
-	compile_static_check (code_path, project_type, libs, output);
+	static_last_elapsed = (gint) ((g_get_monotonic_time () - job->start) / 1000);
+	static_last_hash = job->hash;
+	g_free ((gpointer) static_last_path);
+	static_last_path = g_strdup (job->file_path);
 
+	output = job->output;
 	p = 0;
 	ui_current_editor_error_tag_clear ();
 
@@ -135,7 +226,106 @@ static_check (gpointer data)
 
 	ui_status_image_set (error, warning);
 
-	g_free ((gpointer) output);
+	static_job_free (job);
+
+	return FALSE;
+}
+
+static gpointer
+static_check_job (gpointer data)
+{
+	CStaticJob *job = (CStaticJob *) data;
+
+	job->output = (gchar *) g_malloc (MAX_RESULT_LENGTH + 1);
+	job->output[0] = 0;
+
+	/* Edited before the compiler could even start. */
+	if (job->generation == g_atomic_int_get (&static_generation)) {
+		misc_set_file_content (job->code_path, job->code);
+		compile_static_check (job->code_path, job->type, job->libs, job->output);
+	}
+
+	g_idle_add (static_check_apply, data);
+
+	return NULL;
+}
+
+gboolean 
+static_check (gpointer data)
+{	
+	/* Get current code and check for errors and warnings in the background. */
+	CStaticJob *job;
+	gchar *code;
+	gchar *project_path;
+	gchar file_path[MAX_FILEPATH_LENGTH + 1];
+	gint project_type;
+	gchar libs[MAX_LINE_LENGTH + 1];
+	guint64 hash;
+
+	static_source = 0;
+
+	/* Ask again once the cancelled run is gone. */
+	if (static_running) {
+		static_check_schedule ();
+
+		return FALSE;
+	}
+
+	if (!ui_have_editor () || ui_current_editor_large_file ()) {
+		return FALSE;
+	}
+
+	ui_current_editor_filepath (file_path);
+	project_path = project_current_path ();
+
+	if (project_path == NULL || file_path[0] == 0) {
+		return FALSE;
+	}
+	if (project_get_type () == PROJECT_C && !env_prog_exist (ENV_PROG_GCC)) {
+		if (!static_gcc_warned) {
+			g_warning ("gcc not found.");
+			static_gcc_warned = TRUE;
+		}
+
+		return FALSE;
+	}
+	if (project_get_type () == PROJECT_CPP && !env_prog_exist (ENV_PROG_GPP)) {
+		if (!static_gpp_warned) {
+			g_warning ("g++ not found.");
+			static_gpp_warned = TRUE;
+		}
+
+		return FALSE;
+	}
+
+	project_type = project_get_type ();
+	project_get_settings (libs, MAX_LINE_LENGTH, NULL, 0);
+
+	code = ui_current_editor_code ();
+	if (code == NULL) {
+		return FALSE;
+	}
+
+	/* Nothing changed since the last result. */
+	hash = static_check_hash (code);
+	if (hash == static_last_hash && g_strcmp0 (file_path, static_last_path) == 0) {
+		g_free ((gpointer) code);
+
+		return FALSE;
+	}
+
+	job = (CStaticJob *) g_malloc0 (sizeof (CStaticJob));
+	job->generation = g_atomic_int_get (&static_generation);
+	job->hash = hash;
+	job->start = g_get_monotonic_time ();
+	job->type = project_type;
+	job->code = code;
+	job->code_path = g_strdup_printf ("%s/.static.%s", project_path, project_type? "cpp": "c");
+	job->file_path = g_strdup (file_path);
+	job->libs = g_strdup (libs);
+
+	static_running = TRUE;
+	g_thread_unref (g_thread_new ("static", static_check_job, (gpointer) job));
 
-	return TRUE;
+	return FALSE;
 }
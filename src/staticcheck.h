@@ -30,4 +30,16 @@
 gboolean
 static_check (gpointer data);
 
+void
+static_check_invalidate ();
+
+void
+static_check_schedule ();
+
+void
+static_check_saved (const gchar *filepath);
+
+void
+static_check_reset ();
+
 #endif /* STATICCHECK_H */
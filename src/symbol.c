@@ -35,168 +35,273 @@
 #include "misc.h"
 #include "project.h"
 #include "env.h"
+#include "spancache.h"
+#include "symboldb.h"
+#include "xref.h"
+#include "incgraph.h"
+#include "libindex.h"
 #include "limits.h"
 
-#define CHAR(c) ((c >= 'a' && c <= 'z') || \
- (c >= 'A' && c <= 'Z') || c == '#' || c == '_')
-
-#define DIGIT(c) ((c >= '0' && c <= '9') || c == '.')
-
 extern CWindow *window;
 
-GList *namespace_list;
-GList *function_list;
-GList *variable_list;
-GList *struct_list;
-GList *class_list;
-
-static void
-symbol_clear_class(gpointer ptr);
-
-static void
-symbol_clear_struct(gpointer ptr);
-
-static void
-symbol_clear_namespace(gpointer ptr);
+/* One immutable snapshot of the project symbols. The indexer thread
+ * builds a new one from scratch and the main loop publishes it, readers
+ * hold a reference for as long as they use strings from it.
+ *
+ * The name tables index the lists: keys point into the records, and the
+ * function and variable tables map a name to the chain of all its tags
+ * so that overloads share a slot.
+ *
+ * All records and strings live in one arena: records are carved from
+ * large blocks and strings are interned in a string chunk, so the whole
+ * index goes with a few frees.
+ *
+ * Every tag but locals also gets a location for the symbol search. They
+ * sit in one array of small records sorted by the lowercased name, so a
+ * prefix is a binary search and a fuzzy query a linear walk over it.
+ *
+ * Uses of those names found by xref_scan () make the reference array,
+ * ordered by file and line so that the calls inside a function are one
+ * slice of it, with a second order by name for the references of one
+ * symbol. Both are answered from memory without any cscope run.
+ */
+typedef struct {
+	const gchar *key;
+	const gchar *name;
+	const gchar *scope;
+	const gchar *file;
+	gint line;
+	gchar kind;
+} CSymbolLocation;
+
+typedef struct {
+	const gchar *name;
+	const gchar *file;
+	gint line;
+	gboolean call;
+} CSymbolReference;
+
+/* Slice of the reference array holding one file. */
+typedef struct {
+	guint start;
+	guint n;
+} CSymbolRange;
+
+typedef struct {
+	gint ref_count;
+
+	GList *namespace_list;
+	GList *function_list;
+	GList *variable_list;
+	GList *struct_list;
+	GList *class_list;
+
+	GHashTable *class_table;
+	GHashTable *struct_table;
+	GHashTable *namespace_table;
+	GHashTable *function_table;
+	GHashTable *variable_table;
+
+	GArray *locations;
+	GArray *references;
+	guint *reference_order;
+	GHashTable *reference_files;
+	GHashTable *function_files;
+
+	GSList *blocks;
+	gsize block_used;
+	GStringChunk *strings;
+	const gchar **interned;
+	guint interned_mask;
+	guint interned_used;
+	gsize record_bytes;
+	gsize string_bytes;
+	gsize tag_bytes;
+	guint tags;
+} CSymbolIndex;
+
+#define SYMBOL_BLOCK_SIZE 65536
+
+/* Work order of one indexer run, filled on the main loop. */
+typedef struct {
+	gchar *project_path;
+	GList *header_list;
+	GList *source_list;
+	CSymbolIndex *index;
+} CSymbolJob;
 
-static void
-symbol_clear_function(gpointer ptr);
+static CSymbolIndex *symbol_index;
+static gboolean symbol_running;
 
-static void
-symbol_clear_variable(gpointer ptr);
+/* Headers of the C library and of the project's packages, kept apart from
+ * the project snapshot since they change far less often. The libs string
+ * it was loaded for belongs to the main loop.
+ */
+static CSymbolIndex *symbol_library;
+static gchar *symbol_library_libs;
+static gboolean symbol_library_loading;
 
-static void
-symbol_clear_class(gpointer ptr)
+/* The project's libs as last read, until its settings are saved or another
+ * project is opened.
+ */
+static gchar *symbol_settings_libs;
+static gchar *symbol_settings_project;
+static gboolean symbol_settings_stale;
+
+typedef struct {
+	gchar *libs;
+	CSymbolIndex *index;
+} CSymbolLibraryJob;
+
+/* Owned by the indexer thread; only one job runs at a time. */
+static GHashTable *symbol_files;
+static gchar *symbol_project;
+static guint symbol_tick;
+
+/* Files handed to one ctags run on the indexing pool. */
+#define SYMBOL_SHARD_SIZE 64
+
+/* What the pool found out about one file. */
+typedef struct {
+	const gchar *filepath;
+	CSymbolFile *file;
+	gboolean exists;
+	gboolean touched;
+	gboolean stale;
+	gint64 mtime;
+	gint64 size;
+	guint64 hash;
+	gchar *data;
+	gchar **tags;
+	gchar *ref_data;
+	gchar **refs;
+} CSymbolUpdate;
+
+typedef struct {
+	CSymbolUpdate *updates;
+	gint n;
+} CSymbolShard;
+
+static GThreadPool *symbol_pool;
+static GMutex symbol_pool_mutex;
+static GCond symbol_pool_cond;
+static gint symbol_pool_pending;
+static GMappedFile *symbol_db;
+
+static gpointer
+symbol_alloc (CSymbolIndex *index, gsize size)
 {
-	GList *iterator;
-	CSymbolClass *class_ptr = (CSymbolClass *) ptr;
+	gpointer ptr;
 
-	g_assert (class_ptr->metaclass == META_TYPE_CLASS);
+	size = (size + sizeof (gpointer) - 1) & ~(sizeof (gpointer) - 1);
+	if (index->blocks == NULL || index->block_used + size > SYMBOL_BLOCK_SIZE) {
+		index->blocks = g_slist_prepend (index->blocks, g_malloc (SYMBOL_BLOCK_SIZE));
+		index->block_used = 0;
+	}
 
-	g_debug ("clear c:%s\n", class_ptr->name);
+	ptr = (gchar *) index->blocks->data + index->block_used;
+	index->block_used += size;
+	index->record_bytes += size;
 
-	for (iterator = class_ptr->public_member_list; iterator; iterator = iterator->next) {
-		CSymbolMeta *meta_ptr;
+	return ptr;
+}
 
-		meta_ptr = (CSymbolMeta *) iterator->data;
-		switch (meta_ptr->metaclass) {
-			case META_TYPE_BASE:
-				symbol_clear_variable ((gpointer *) meta_ptr);
-				break;
-			case META_TYPE_FUNCTION:
-				symbol_clear_function ((gpointer *) meta_ptr);
-				break;
-			case META_TYPE_CLASS:
-				symbol_clear_class ((gpointer *) meta_ptr);
-				break;
-			case META_TYPE_STRUCT:
-				symbol_clear_struct ((gpointer *) meta_ptr);
-				break;
-			case META_TYPE_NAMESPACE:
-				symbol_clear_namespace ((gpointer *) meta_ptr);
-				break;
-		}
+static guint
+symbol_intern_hash (const gchar *str, const gint len)
+{
+	guint hash;
+	gint i;
+
+	hash = 2166136261U;
+	for (i = 0; i < len; i++) {
+		hash = (hash ^ (guchar) str[i]) * 16777619U;
 	}
-	g_list_free (class_ptr->public_member_list);
-	g_list_free (class_ptr->public_function_list);
 
-	g_free (ptr);
+	return hash;
 }
 
 static void
-symbol_clear_struct(gpointer ptr)
+symbol_intern_grow (CSymbolIndex *index)
 {
-	GList *iterator;
-	CSymbolStruct *struct_ptr = (CSymbolStruct *) ptr;
+	const gchar **old;
+	guint old_size;
+	guint i;
 
-	g_assert (struct_ptr->metaclass == META_TYPE_STRUCT);
+	old = index->interned;
+	old_size = index->interned_mask + 1;
+	index->interned_mask = old_size * 2 - 1;
+	index->interned = g_new0 (const gchar *, old_size * 2);
 
-	g_debug ("clear s:%s\n", struct_ptr->name);
+	for (i = 0; i < old_size; i++) {
+		guint slot;
 
-	for (iterator = struct_ptr->member_list; iterator; iterator = iterator->next) {
-		CSymbolMeta *meta_ptr;
-
-		meta_ptr = (CSymbolMeta *) iterator->data;
-		switch (meta_ptr->metaclass) {
-		case META_TYPE_BASE:
-			symbol_clear_variable ((gpointer *) meta_ptr);
-			break;
-		case META_TYPE_FUNCTION:
-			symbol_clear_function ((gpointer *) meta_ptr);
-			break;
-		case META_TYPE_CLASS:
-			symbol_clear_class ((gpointer *) meta_ptr);
-			break;
-		case META_TYPE_STRUCT:
-			symbol_clear_struct ((gpointer *) meta_ptr);
-			break;
-		case META_TYPE_NAMESPACE:
-			symbol_clear_namespace ((gpointer *) meta_ptr);
-			break;
+		if (old[i] == NULL) {
+			continue;
 		}
+		slot = symbol_intern_hash (old[i], strlen (old[i])) & index->interned_mask;
+		while (index->interned[slot] != NULL) {
+			slot = (slot + 1) & index->interned_mask;
+		}
+		index->interned[slot] = old[i];
 	}
-	g_list_free (struct_ptr->member_list);
-	g_list_free (struct_ptr->function_list);
 
-	g_free (ptr);
+	g_free ((gpointer) old);
 }
 
-static void
-symbol_clear_namespace(gpointer ptr)
+static guint
+symbol_intern_slot (CSymbolIndex *index, const gchar *str, const gint len)
 {
-	GList *iterator;
-	CSymbolNamespace *namespace_ptr = (CSymbolNamespace *) ptr;
-
-	g_assert (namespace_ptr->metaclass == META_TYPE_NAMESPACE);
-
-	g_debug ("clear n:%s\n", namespace_ptr->name);
-
-	for (iterator = namespace_ptr->member_list; iterator; iterator = iterator->next) {
-		CSymbolMeta *meta_ptr;
+	const gchar *interned;
+	guint slot;
 
-		meta_ptr = (CSymbolMeta *) iterator->data;
-		switch (meta_ptr->metaclass) {
-		case META_TYPE_BASE:
-			symbol_clear_variable ((gpointer *) meta_ptr);
-			break;
-		case META_TYPE_FUNCTION:
-			symbol_clear_function ((gpointer *) meta_ptr);
-			break;
-		case META_TYPE_CLASS:
-			symbol_clear_class ((gpointer *) meta_ptr);
-			break;
-		case META_TYPE_STRUCT:
-			symbol_clear_struct ((gpointer *) meta_ptr);
-			break;
-		case META_TYPE_NAMESPACE:
-			symbol_clear_namespace ((gpointer *) meta_ptr);
+	slot = symbol_intern_hash (str, len) & index->interned_mask;
+	while ((interned = index->interned[slot]) != NULL) {
+		/* strncmp stops at the end of a shorter interned string. */
+		if (strncmp (interned, str, len) == 0 && interned[len] == 0) {
 			break;
 		}
+		slot = (slot + 1) & index->interned_mask;
 	}
-	g_list_free (namespace_ptr->member_list);
-	g_list_free (namespace_ptr->function_list);
 
-	g_free (ptr);
+	return slot;
 }
 
-static void
-symbol_clear_function (gpointer ptr)
+/* The interned copy of str[0..len), NULL if the index has none. */
+static const gchar *
+symbol_intern_find (CSymbolIndex *index, const gchar *str, const gint len)
 {
-	CSymbolFunction *function_ptr = (CSymbolFunction *) ptr;
-
-	g_debug ("clear f:%s:%s\n", function_ptr->name, function_ptr->sign);
-
-	g_free (ptr);
+	return index->interned[symbol_intern_slot (index, str, len)];
 }
 
-static void
-symbol_clear_variable (gpointer ptr)
+/* The one copy of str[0..len) in the index, str need not be nul terminated
+ * so fields are interned straight from the tag line.
+ */
+static const gchar *
+symbol_intern_len (CSymbolIndex *index, const gchar *str, const gint len)
 {
-	CSymbolVariable *variable_ptr = (CSymbolVariable *) ptr;
+	const gchar *interned;
+	guint slot;
+
+	slot = symbol_intern_slot (index, str, len);
+	if (index->interned[slot] != NULL) {
+		return index->interned[slot];
+	}
+
+	interned = g_string_chunk_insert_len (index->strings, str, len);
+	index->interned[slot] = interned;
+	index->string_bytes += len + 1;
 
-	g_debug ("clear v:%s:%s\n", variable_ptr->type, variable_ptr->name);
+	if (++index->interned_used * 2 > index->interned_mask) {
+		symbol_intern_grow (index);
+	}
+
+	return interned;
+}
 
-	g_free (ptr);
+static const gchar *
+symbol_intern (CSymbolIndex *index, const gchar *str)
+{
+	return symbol_intern_len (index, str, strlen (str));
 }
 
 static void
@@ -243,512 +348,1377 @@ symbol_debug_dump (gpointer *ptr, gint level)
 }
 
 static void
-symbol_debug()
+symbol_debug (CSymbolIndex *index)
 {
 	GList *iterator;
 
 	g_debug("dump class\n");
-	for (iterator = class_list; iterator; iterator = iterator->next) {
+	for (iterator = index->class_list; iterator; iterator = iterator->next) {
 		symbol_debug_dump (iterator->data, 1);
 	}
 	g_debug("dump struct\n");
-	for (iterator = struct_list; iterator; iterator = iterator->next) {
+	for (iterator = index->struct_list; iterator; iterator = iterator->next) {
 		symbol_debug_dump (iterator->data, 1);
 	}
 	g_debug("dump namespace\n");
-	for (iterator = namespace_list; iterator; iterator = iterator->next) {
+	for (iterator = index->namespace_list; iterator; iterator = iterator->next) {
 		symbol_debug_dump (iterator->data, 1);
 	}
 	g_debug("dump function\n");
-	for (iterator = function_list; iterator; iterator = iterator->next) {
+	for (iterator = index->function_list; iterator; iterator = iterator->next) {
 		symbol_debug_dump (iterator->data, 1);
 	}
 	g_debug("dump variable\n");
-	for (iterator = variable_list; iterator; iterator = iterator->next) {
+	for (iterator = index->variable_list; iterator; iterator = iterator->next) {
 		symbol_debug_dump (iterator->data, 1);
 	}
 }
 
 static CSymbolClass *
-symbol_find_class (const gchar *name)
+symbol_find_class (CSymbolIndex *index, const gchar *name)
 {
-	GList *iterator;
+	return (CSymbolClass *) g_hash_table_lookup (index->class_table, name);
+}
+
+static CSymbolStruct *
+symbol_find_struct (CSymbolIndex *index, const gchar *name)
+{
+	return (CSymbolStruct *) g_hash_table_lookup (index->struct_table, name);
+}
 
-	for (iterator = class_list; iterator; iterator = iterator->next) {
-		CSymbolClass *class_ptr;
+static CSymbolNamespace *
+symbol_find_namespace (CSymbolIndex *index, const gchar *name)
+{
+	return (CSymbolNamespace *) g_hash_table_lookup (index->namespace_table, name);
+}
 
-		class_ptr = (CSymbolClass *) iterator->data;
-		if (g_strcmp0 (class_ptr->name, name) == 0) {
-			return class_ptr;
-		}
+static CSymbolClass *
+symbol_ensure_class (CSymbolIndex *index, const gchar *name)
+{
+	CSymbolClass *class_ptr;
+
+	class_ptr = symbol_find_class (index, name);
+	if (class_ptr == NULL) {
+		class_ptr = (CSymbolClass *) symbol_alloc (index, sizeof (CSymbolClass));
+		class_ptr->name = name;
+		class_ptr->metaclass = META_TYPE_CLASS;
+		class_ptr->public_member_list = NULL;
+		class_ptr->public_function_list = NULL;
+
+		index->class_list = g_list_prepend (index->class_list, class_ptr);
+		g_hash_table_insert (index->class_table, (gpointer) class_ptr->name, class_ptr);
 	}
 
-	return NULL;
+	return class_ptr;
 }
 
 static CSymbolStruct *
-symbol_find_struct (const gchar *name)
+symbol_ensure_struct (CSymbolIndex *index, const gchar *name)
 {
-	GList *iterator;
+	CSymbolStruct *struct_ptr;
 
-	for (iterator = struct_list; iterator; iterator = iterator->next) {
-		CSymbolStruct *struct_ptr;
+	struct_ptr = symbol_find_struct (index, name);
+	if (struct_ptr == NULL) {
+		struct_ptr = (CSymbolStruct *) symbol_alloc (index, sizeof (CSymbolStruct));
+		struct_ptr->name = name;
+		struct_ptr->metaclass = META_TYPE_STRUCT;
+		struct_ptr->member_list = NULL;
+		struct_ptr->function_list = NULL;
 
-		struct_ptr = (CSymbolStruct *) iterator->data;
-		if (g_strcmp0 (struct_ptr->name, name) == 0) {
-			return struct_ptr;
-		}
+		index->struct_list = g_list_prepend (index->struct_list, struct_ptr);
+		g_hash_table_insert (index->struct_table, (gpointer) struct_ptr->name, struct_ptr);
 	}
 
-	return NULL;
+	return struct_ptr;
 }
 
 static CSymbolNamespace *
-symbol_find_namespace (const gchar *name)
+symbol_ensure_namespace (CSymbolIndex *index, const gchar *name)
 {
-	GList *iterator;
+	CSymbolNamespace *namespace_ptr;
 
-	for (iterator = namespace_list; iterator; iterator = iterator->next) {
-		CSymbolNamespace *namespace_ptr;
+	namespace_ptr = symbol_find_namespace (index, name);
+	if (namespace_ptr == NULL) {
+		namespace_ptr = (CSymbolNamespace *) symbol_alloc (index, sizeof (CSymbolNamespace));
+		namespace_ptr->name = name;
+		namespace_ptr->metaclass = META_TYPE_NAMESPACE;
+		namespace_ptr->member_list = NULL;
+		namespace_ptr->function_list = NULL;
 
-		namespace_ptr = (CSymbolNamespace *) iterator->data;
-		if (g_strcmp0 (namespace_ptr->name, name) == 0) {
-			return namespace_ptr;
-		}
+		index->namespace_list = g_list_prepend (index->namespace_list, namespace_ptr);
+		g_hash_table_insert (index->namespace_table, (gpointer) namespace_ptr->name, namespace_ptr);
 	}
 
-	return NULL;
+	return namespace_ptr;
 }
 
+/* Adds ptr to the chain of name in table. Chains are built in reverse
+ * and put back in tag order by symbol_finish.
+ */
 static void
-symbol_read_token (const gchar *line, gchar *token, gint *offset, gint *ftoffset)
+symbol_chain (GHashTable *table, const gchar *name, gpointer ptr)
 {
-	sscanf (line + (*offset), "%s", token);
-	for ((*ftoffset) = strlen (token) - 1; ; (*ftoffset)--) {
-		if (token[*ftoffset] == ':') {
-			break;
-		}
+	GList *chain;
+
+	chain = (GList *) g_hash_table_lookup (table, name);
+	g_hash_table_insert (table, (gpointer) name, g_list_prepend (chain, ptr));
+}
+
+/* Value of a "key:value" field after its last colon, which drops the
+ * kind from "typeref:struct:name" and the outer scopes from "ns::name".
+ */
+static const gchar *
+symbol_field_name (const gchar *value, const gchar *end, gint *len)
+{
+	const gchar *p;
+
+	for (p = end; p > value && p[-1] != ':'; p--) {
 	}
-	(*ftoffset)++;
-	(*offset) += strlen (token) + 1;
+	*len = end - p;
+
+	return p;
 }
 
 static void
-symbol_parse_line (const gchar *line)
+symbol_locate (CSymbolIndex *index, const gchar *name, const gint name_len,
+			   const gchar *file, const gint file_len, const gint line, const gchar kind,
+			   const gchar *scope, const gint scope_len)
 {
-	gchar name[MAX_LINE_LENGTH + 1];
-	gchar type[MAX_LINE_LENGTH + 1];
-	gchar token[MAX_LINE_LENGTH + 1];
-	gint offset;
-	gint ftoffset;
-	CSymbolClass *class_ptr;
-	CSymbolStruct *struct_ptr;
-	CSymbolNamespace *namespace_ptr;
+	CSymbolLocation location;
+	gchar key[MAX_VARNAME_LENGTH + 1];
+	gboolean lower;
+	gint len;
+	gint i;
 
-	sscanf(line, "%s", name);
-	offset = 0;
-	while (line[offset] != '\"') {
-		offset++;
+	location.name = symbol_intern_len (index, name, name_len);
+	location.scope = scope != NULL? symbol_intern_len (index, scope, scope_len): NULL;
+	location.file = symbol_intern_len (index, file, file_len);
+	location.line = line;
+	location.kind = kind;
+
+	/* Most names are lowercase already and share the interned string. */
+	len = MIN (name_len, MAX_VARNAME_LENGTH);
+	lower = TRUE;
+	for (i = 0; i < len; i++) {
+		key[i] = g_ascii_tolower (name[i]);
+		lower = lower && key[i] == name[i];
 	}
-	offset++;
+	location.key = lower && len == name_len? location.name: symbol_intern_len (index, key, len);
 
-	sscanf (line + offset, "%s", type);
-	offset += strlen (type) + 2;
+	g_array_append_val (index->locations, location);
+}
 
-	if (type[0] == 'm') {
-		CSymbolVariable *variable_ptr;
+/* Parses one ctags line in place, fields are found with memchr and only
+ * interned, never copied out. The layout is
+ *   name <tab> file <tab> ex command ;" <tab> kind [<tab> key:value]...
+ */
+static void
+symbol_parse_line (CSymbolIndex *index, const gchar *line, const gchar *end)
+{
+	const gchar *name;
+	gint name_len;
+	const gchar *file;
+	gint file_len;
+	gint lineno;
+	gchar kind;
+	gchar scope_kind;
+	const gchar *scope;
+	gint scope_len;
+	const gchar *typeref;
+	gint typeref_len;
+	gboolean typeref_class;
+	const gchar *sign;
+	gint sign_len;
+	const gchar *p;
+	CSymbolClass *class_ptr;
+	CSymbolStruct *struct_ptr;
+	CSymbolNamespace *namespace_ptr;
+	gpointer ptr;
 
-		variable_ptr = (CSymbolVariable *) g_malloc (sizeof (CSymbolVariable));
-		g_strlcpy (variable_ptr->type, "base", MAX_VARNAME_LENGTH);
-		g_strlcpy (variable_ptr->name, name, MAX_TYPENAME_LENGTH);
-		variable_ptr->metaclass = META_TYPE_BASE;
+	p = memchr (line, '\t', end - line);
+	if (p == NULL) {
+		return;
+	}
+	name = line;
+	name_len = p - line;
 
-		token[0] = 0;
-		symbol_read_token (line, token, &offset, &ftoffset);
-
-		switch (token[0]) {
-		case 'c':
-			class_ptr = symbol_find_class (token + ftoffset);
-			if (class_ptr == NULL) {
-				class_ptr = (CSymbolClass *) g_malloc (sizeof (CSymbolClass));
-				g_strlcpy (class_ptr->name, token + ftoffset, MAX_TYPENAME_LENGTH);
-				class_ptr->metaclass = META_TYPE_CLASS;
-				class_ptr->public_member_list = NULL;
-				class_ptr->public_function_list = NULL;
-				class_ptr->public_member_list = g_list_append (class_ptr->public_member_list, 
-															   variable_ptr);
-
-				class_list = g_list_append (class_list, class_ptr);
-			}
-			else {
-				class_ptr->public_member_list = g_list_append (class_ptr->public_member_list, 
-															   variable_ptr);
-			}
+	file = p + 1;
+	p = memchr (file, '\t', end - file);
+	if (p == NULL) {
+		return;
+	}
+	file_len = p - file;
 
+	/* The ex command may hold anything, it ends at the first ;" tab. */
+	for (p++; (p = memchr (p, '"', end - p)) != NULL; p++) {
+		if (p[-1] == ';' && (p + 1 == end || p[1] == '\t')) {
 			break;
+		}
+	}
+	if (p == NULL) {
+		return;
+	}
+	p++;
+
+	kind = 0;
+	scope_kind = 0;
+	scope = NULL;
+	scope_len = 0;
+	typeref = NULL;
+	typeref_len = 0;
+	typeref_class = FALSE;
+	sign = NULL;
+	sign_len = 0;
+	lineno = 0;
+	while (p < end) {
+		const gchar *field;
+		const gchar *field_end;
+		const gchar *colon;
+		gint key_len;
+
+		field = p + 1;
+		field_end = memchr (field, '\t', end - field);
+		if (field_end == NULL) {
+			field_end = end;
+		}
+		p = field_end;
 
-		case 's':
-			struct_ptr = symbol_find_struct (token + ftoffset);
-
-			if (struct_ptr == NULL) {
-				struct_ptr = (CSymbolStruct *) g_malloc (sizeof (CSymbolStruct));
-				g_strlcpy (struct_ptr->name, token + ftoffset, MAX_TYPENAME_LENGTH);
-				struct_ptr->metaclass = META_TYPE_STRUCT;
-				struct_ptr->member_list = NULL;
-				struct_ptr->function_list = NULL;
-				struct_ptr->member_list = g_list_append (struct_ptr->member_list, 
-														 variable_ptr);
-
-				struct_list = g_list_append (struct_list, struct_ptr);
+		colon = memchr (field, ':', field_end - field);
+		if (colon == NULL) {
+			if (kind == 0 && field < field_end) {
+				kind = field[0];
 			}
-			else {
-				struct_ptr->member_list = g_list_append (struct_ptr->member_list, 
-														 variable_ptr);
-			}
-
-			break;
+			continue;
+		}
 
-		case 'n':
-			namespace_ptr = symbol_find_namespace (token + ftoffset);
+		key_len = colon - field;
+		if ((key_len == 5 && memcmp (field, "class", 5) == 0) ||
+			(key_len == 6 && memcmp (field, "struct", 6) == 0) ||
+			(key_len == 9 && memcmp (field, "namespace", 9) == 0)) {
+			scope_kind = field[0];
+			scope = symbol_field_name (colon + 1, field_end, &scope_len);
+		}
+		else if (key_len == 7 && memcmp (field, "typeref", 7) == 0) {
+			typeref = symbol_field_name (colon + 1, field_end, &typeref_len);
+			typeref_class = g_str_has_prefix (colon + 1, "class:");
+		}
+		else if (key_len == 9 && memcmp (field, "signature", 9) == 0) {
+			sign = colon + 1;
+			sign_len = field_end - sign;
+		}
+		else if (key_len == 4 && memcmp (field, "line", 4) == 0) {
+			lineno = atoi (colon + 1);
+		}
+	}
 
-			if (namespace_ptr == NULL) {
-				namespace_ptr = (CSymbolNamespace *) g_malloc (sizeof (CSymbolNamespace));
-				g_strlcpy (namespace_ptr->name, token + ftoffset, MAX_TYPENAME_LENGTH);
-				namespace_ptr->metaclass = META_TYPE_NAMESPACE;
-				namespace_ptr->member_list = NULL;
-				namespace_ptr->function_list = NULL;
-				namespace_ptr->member_list = g_list_append (namespace_ptr->member_list, 
-															variable_ptr);
+	index->tags++;
+	index->tag_bytes += end - line + 1;
 
-				namespace_list = g_list_append (namespace_list, namespace_ptr);
-			}
-			else {
-				namespace_ptr->member_list = g_list_append (namespace_ptr->member_list, 
-															variable_ptr);
-			}
+	if (kind != 'l' && kind != 0) {
+		symbol_locate (index, name, name_len, file, file_len, lineno, kind,
+					   scope, scope_len);
+	}
 
-			break;
+	if (kind == 'm' || kind == 'v' || kind == 'l') {
+		CSymbolVariable *variable_ptr;
 
+		variable_ptr = (CSymbolVariable *) symbol_alloc (index, sizeof (CSymbolVariable));
+		variable_ptr->name = symbol_intern_len (index, name, name_len);
+		variable_ptr->metaclass = META_TYPE_BASE;
+		if (typeref != NULL) {
+			variable_ptr->type = symbol_intern_len (index, typeref, typeref_len);
+			if (kind != 'm') {
+				variable_ptr->metaclass = typeref_class? META_TYPE_CLASS: META_TYPE_STRUCT;
+			}
 		}
-		
-		token[0] = 0;
-		symbol_read_token (line, token, &offset, &ftoffset);
-		if (token[0] == 0) {
-			return;
+		else {
+			variable_ptr->type = symbol_intern (index, "base");
 		}
 
-		if (token[0] == 't') {
-			g_strlcpy (variable_ptr->type, token + ftoffset, MAX_TYPENAME_LENGTH);
+		if (kind != 'm') {
+			index->variable_list = g_list_prepend (index->variable_list, variable_ptr);
+			symbol_chain (index->variable_table, variable_ptr->name, variable_ptr);
+
+			return;
 		}
+		ptr = variable_ptr;
 	}
-	else if (type[0] == 'f') {
+	else if (kind == 'f' || kind == 'p') {
 		CSymbolFunction *function_ptr;
 
-		function_ptr = (CSymbolFunction *) g_malloc (sizeof (CSymbolFunction));
-		g_strlcpy (function_ptr->name, name, MAX_TYPENAME_LENGTH);
+		function_ptr = (CSymbolFunction *) symbol_alloc (index, sizeof (CSymbolFunction));
+		function_ptr->name = symbol_intern_len (index, name, name_len);
 		function_ptr->metaclass = META_TYPE_FUNCTION;
-		function_ptr->sign[0] = 0;
+		function_ptr->sign = symbol_intern_len (index, sign != NULL? sign: "", sign_len);
 
-		function_list = g_list_append (function_list, function_ptr);
+		index->function_list = g_list_prepend (index->function_list, function_ptr);
+		symbol_chain (index->function_table, function_ptr->name, function_ptr);
+		ptr = function_ptr;
+	}
+	else {
+		return;
+	}
 
-		if (!line[offset] || (line[offset] == 's' && line[offset + 1] == 'i')) {
-			if (line[offset]) {
-				g_strlcpy (function_ptr->sign, line + offset + 10, MAX_SIGN_LENGTH);
-			}
+	if (scope == NULL) {
+		return;
+	}
 
-			return;
+	switch (scope_kind) {
+	case 'c':
+		class_ptr = symbol_ensure_class (index, symbol_intern_len (index, scope, scope_len));
+		if (kind == 'm') {
+			class_ptr->public_member_list = g_list_prepend (class_ptr->public_member_list, ptr);
 		}
+		else {
+			class_ptr->public_function_list = g_list_prepend (class_ptr->public_function_list, ptr);
+		}
+		break;
 
-		token[0] = 0;
-		symbol_read_token (line, token, &offset, &ftoffset);
-
-		switch (token[0]) {
-		case 'c':
-			class_ptr = symbol_find_class (token + ftoffset);
-			if (class_ptr == NULL) {
-				class_ptr = (CSymbolClass *) g_malloc (sizeof (CSymbolClass));
-				g_strlcpy (class_ptr->name, token + ftoffset, MAX_TYPENAME_LENGTH);
-				class_ptr->metaclass = META_TYPE_CLASS;
-				class_ptr->public_member_list = NULL;
-				class_ptr->public_function_list = NULL;
-				class_ptr->public_function_list = g_list_append (class_ptr->public_function_list, 
-																 function_ptr);
+	case 's':
+		struct_ptr = symbol_ensure_struct (index, symbol_intern_len (index, scope, scope_len));
+		if (kind == 'm') {
+			struct_ptr->member_list = g_list_prepend (struct_ptr->member_list, ptr);
+		}
+		else {
+			struct_ptr->function_list = g_list_prepend (struct_ptr->function_list, ptr);
+		}
+		break;
 
-				class_list = g_list_append (class_list, class_ptr);
-			}
-			else {
-				class_ptr->public_function_list = g_list_append (class_ptr->public_function_list, 
-																 function_ptr);
-			}
+	case 'n':
+		namespace_ptr = symbol_ensure_namespace (index, symbol_intern_len (index, scope, scope_len));
+		if (kind == 'm') {
+			namespace_ptr->member_list = g_list_prepend (namespace_ptr->member_list, ptr);
+		}
+		else {
+			namespace_ptr->function_list = g_list_prepend (namespace_ptr->function_list, ptr);
+		}
+		break;
+	}
+}
 
-			break;
+static void
+symbol_finish_table (GHashTable *table)
+{
+	GHashTableIter iter;
+	gpointer value;
 
-		case 's':
-			struct_ptr = symbol_find_struct (token + ftoffset);
+	g_hash_table_iter_init (&iter, table);
+	while (g_hash_table_iter_next (&iter, NULL, &value)) {
+		g_hash_table_iter_replace (&iter, g_list_reverse ((GList *) value));
+	}
+}
 
-			if (struct_ptr == NULL) {
-				struct_ptr = (CSymbolStruct *) g_malloc (sizeof (CSymbolStruct));
-				g_strlcpy (struct_ptr->name, token + ftoffset, MAX_TYPENAME_LENGTH);
-				struct_ptr->metaclass = META_TYPE_STRUCT;
-				struct_ptr->member_list = NULL;
-				struct_ptr->function_list = NULL;
-				struct_ptr->function_list = g_list_append (struct_ptr->function_list, 
-														   function_ptr);
+static gint
+symbol_location_compare (gconstpointer a, gconstpointer b)
+{
+	const CSymbolLocation *la = (const CSymbolLocation *) a;
+	const CSymbolLocation *lb = (const CSymbolLocation *) b;
+	gint result;
 
-				struct_list = g_list_append (struct_list, struct_ptr);
-			}
-			else {
-				struct_ptr->function_list = g_list_append (struct_ptr->function_list, 
-														   function_ptr);
-			}
+	result = strcmp (la->key, lb->key);
+	if (result == 0 && la->name != lb->name) {
+		result = strcmp (la->name, lb->name);
+	}
+	if (result == 0 && la->file != lb->file) {
+		result = strcmp (la->file, lb->file);
+	}
+	if (result == 0) {
+		result = la->line - lb->line;
+	}
 
-			break;
+	return result;
+}
 
-		case 'n':
-			namespace_ptr = symbol_find_namespace (token + ftoffset);
+/* The parser prepends everywhere to stay linear; restore tag order. */
+static void
+symbol_finish (CSymbolIndex *index)
+{
+	GList *iterator;
 
-			if (namespace_ptr == NULL) {
-				namespace_ptr = (CSymbolNamespace *) g_malloc (sizeof (CSymbolNamespace));
-				g_strlcpy (namespace_ptr->name, token + ftoffset, MAX_TYPENAME_LENGTH);
-				namespace_ptr->metaclass = META_TYPE_NAMESPACE;
-				namespace_ptr->member_list = NULL;
-				namespace_ptr->function_list = NULL;
-				namespace_ptr->function_list = g_list_append (namespace_ptr->function_list, 
-															  function_ptr);
+	index->class_list = g_list_reverse (index->class_list);
+	for (iterator = index->class_list; iterator; iterator = iterator->next) {
+		CSymbolClass *class_ptr = (CSymbolClass *) iterator->data;
 
-				namespace_list = g_list_append (namespace_list, namespace_ptr);
-			}
-			else {
-				namespace_ptr->function_list = g_list_append (namespace_ptr->function_list, 
-															  function_ptr);
-			}
+		class_ptr->public_member_list = g_list_reverse (class_ptr->public_member_list);
+		class_ptr->public_function_list = g_list_reverse (class_ptr->public_function_list);
+	}
 
-			break;
-		}
+	index->struct_list = g_list_reverse (index->struct_list);
+	for (iterator = index->struct_list; iterator; iterator = iterator->next) {
+		CSymbolStruct *struct_ptr = (CSymbolStruct *) iterator->data;
 
-		if (token[0] == 'c' || token[0] == 's') {
-			token[0] = 0;
-			symbol_read_token (line, token, &offset, &ftoffset);
-		}
+		struct_ptr->member_list = g_list_reverse (struct_ptr->member_list);
+		struct_ptr->function_list = g_list_reverse (struct_ptr->function_list);
+	}
 
-		if (token[0] == 's' && token[1] == 'i') {
-			offset -= strlen (token) + 1;
-		}
+	index->namespace_list = g_list_reverse (index->namespace_list);
+	for (iterator = index->namespace_list; iterator; iterator = iterator->next) {
+		CSymbolNamespace *namespace_ptr = (CSymbolNamespace *) iterator->data;
 
-		if (strlen (token) > 2 && token[0] == 's' && token[1] == 'i') {
-			g_strlcpy (function_ptr->sign, line + offset + 10, MAX_SIGN_LENGTH);
-		}
-		else {
-			function_ptr->sign[0] = 0;
-		}
+		namespace_ptr->member_list = g_list_reverse (namespace_ptr->member_list);
+		namespace_ptr->function_list = g_list_reverse (namespace_ptr->function_list);
 	}
-	else if (type[0] == 'v' || type[0] == 'l') {
-		CSymbolVariable *variable_ptr;
 
-		variable_ptr = (CSymbolVariable *) g_malloc (sizeof (CSymbolVariable));
-		g_strlcpy (variable_ptr->type, "base", MAX_VARNAME_LENGTH);
-		g_strlcpy (variable_ptr->name, name, MAX_TYPENAME_LENGTH);
-		variable_ptr->metaclass = META_TYPE_BASE;
+	index->function_list = g_list_reverse (index->function_list);
+	index->variable_list = g_list_reverse (index->variable_list);
 
-		if (line[offset] == 't') {
-			token[0] = 0;
-			symbol_read_token (line, token, &offset, &ftoffset);
-			g_strlcpy (variable_ptr->type, token + ftoffset, MAX_TYPENAME_LENGTH);
-			variable_ptr->metaclass = (token[8] == 'c'? META_TYPE_CLASS: META_TYPE_STRUCT);
+	symbol_finish_table (index->function_table);
+	symbol_finish_table (index->variable_table);
 
-		}
-		variable_list = g_list_append (variable_list, variable_ptr);
-	}
+	g_array_sort (index->locations, symbol_location_compare);
+	index->record_bytes += index->locations->len * sizeof (CSymbolLocation);
 }
 
 static void
-symbol_clear ()
+symbol_clear_table (GHashTable *table)
 {
-	g_list_free_full (class_list, symbol_clear_class);
-	class_list = NULL;
-	
-	g_list_free_full (struct_list, symbol_clear_struct);
-	struct_list = NULL;
-	
-	g_list_free_full (namespace_list, symbol_clear_namespace);
-	namespace_list = NULL;
-
-	g_list_free_full (function_list, symbol_clear_function);
-	function_list = NULL;
+	GHashTableIter iter;
+	gpointer value;
 
-	g_list_free_full (variable_list, symbol_clear_variable);
-	variable_list = NULL;
+	g_hash_table_iter_init (&iter, table);
+	while (g_hash_table_iter_next (&iter, NULL, &value)) {
+		g_list_free ((GList *) value);
+	}
+	g_hash_table_remove_all (table);
 }
 
-void
-symbol_init ()
+static void
+symbol_shard_index (gpointer data, gpointer user_data);
+
+static CSymbolIndex *
+symbol_index_new ()
 {
-	class_list = NULL;
-	struct_list = NULL;
-	namespace_list = NULL;
-	function_list = NULL;
-	variable_list = NULL;
+	CSymbolIndex *index;
+
+	index = (CSymbolIndex *) g_malloc0 (sizeof (CSymbolIndex));
+	index->ref_count = 1;
+
+	index->class_table = g_hash_table_new (g_str_hash, g_str_equal);
+	index->struct_table = g_hash_table_new (g_str_hash, g_str_equal);
+	index->namespace_table = g_hash_table_new (g_str_hash, g_str_equal);
+	index->function_table = g_hash_table_new (g_str_hash, g_str_equal);
+	index->variable_table = g_hash_table_new (g_str_hash, g_str_equal);
+
+	index->locations = g_array_new (FALSE, FALSE, sizeof (CSymbolLocation));
+	index->references = g_array_new (FALSE, FALSE, sizeof (CSymbolReference));
+	index->reference_files = g_hash_table_new (g_direct_hash, g_direct_equal);
+	index->function_files = g_hash_table_new_full (g_direct_hash, g_direct_equal,
+												   NULL, (GDestroyNotify) g_array_unref);
+
+	index->strings = g_string_chunk_new (SYMBOL_BLOCK_SIZE);
+	index->interned_mask = 1023;
+	index->interned = g_new0 (const gchar *, index->interned_mask + 1);
+
+	return index;
 }
 
-gboolean 
-symbol_parse (gpointer data)
+static void
+symbol_index_free (CSymbolIndex *index)
 {
-	gchar *project_path;
-	FILE *ctags;
-	gchar line[MAX_LINE_LENGTH + 1];
-	gint i;
-	gint ret;
-	gchar *ret2;
+	GList *iterator;
 
-	if (!env_prog_exist (ENV_PROG_CTAGS) || !env_prog_exist (ENV_PROG_CSCOPE)) {
-		g_warning ("ctags or cscope not found.");
+	g_hash_table_destroy (index->class_table);
+	g_hash_table_destroy (index->struct_table);
+	g_hash_table_destroy (index->namespace_table);
+	symbol_clear_table (index->function_table);
+	g_hash_table_destroy (index->function_table);
+	symbol_clear_table (index->variable_table);
+	g_hash_table_destroy (index->variable_table);
 
-		return FALSE;
-	}
-	symbol_clear ();
+	for (iterator = index->class_list; iterator; iterator = iterator->next) {
+		CSymbolClass *class_ptr = (CSymbolClass *) iterator->data;
 
-	project_path = project_current_path ();
+		g_list_free (class_ptr->public_member_list);
+		g_list_free (class_ptr->public_function_list);
+	}
+	g_list_free (index->class_list);
 
-	if (project_path == NULL)
-		return TRUE;
+	for (iterator = index->struct_list; iterator; iterator = iterator->next) {
+		CSymbolStruct *struct_ptr = (CSymbolStruct *) iterator->data;
 
-	ret = chdir (project_path);
-	if (ret == -1) {
-		g_error ("failed to chdir to %s while parsing symbol.", project_path);
-		
-		return FALSE;
+		g_list_free (struct_ptr->member_list);
+		g_list_free (struct_ptr->function_list);
 	}
+	g_list_free (index->struct_list);
 
-	ret = system ("ctags -R --fields=ksSta --c++-kinds=+l --c-kinds=+l --exclude=Makefile *");
-	if (ret != 0) {
-		g_warning ("executing ctags returned %d.", ret);
+	for (iterator = index->namespace_list; iterator; iterator = iterator->next) {
+		CSymbolNamespace *namespace_ptr = (CSymbolNamespace *) iterator->data;
 
-		return FALSE;
+		g_list_free (namespace_ptr->member_list);
+		g_list_free (namespace_ptr->function_list);
 	}
+	g_list_free (index->namespace_list);
 
-	ctags = g_fopen ("tags", "r");
-	if (ctags == NULL) {
-		g_warning ("can't open tag file, you might want to check whether ctags is installed.");
-		ui_status_entry_new (FILE_OP_WARNING, _("can't open tag file, please check whether ctags is installed."));
+	g_list_free (index->function_list);
+	g_list_free (index->variable_list);
 
-		return FALSE;
-	}
+	g_array_free (index->locations, TRUE);
+	g_array_free (index->references, TRUE);
+	g_free ((gpointer) index->reference_order);
+	g_hash_table_destroy (index->reference_files);
+	g_hash_table_destroy (index->function_files);
 
-	for (i = 0; i < 6; i++) {
-		ret2 = fgets (line, MAX_LINE_LENGTH, ctags);
+	/* Every record and string goes at once. */
+	g_slist_free_full (index->blocks, g_free);
+	g_free ((gpointer) index->interned);
+	g_string_chunk_free (index->strings);
 
-		if (ret2 == NULL) {
-			g_error ("failed to skip tag headers.");
+	g_free (index);
+}
 
-			/* This is stupid, why doesn't glic provide a g_fclose? */
-			fclose (ctags);
+/* Takes a reference on the published snapshot, NULL if there is none.
+ * Snapshots are only replaced from the main loop, so a reader on the main
+ * loop can never see one being released under it.
+ */
+static CSymbolIndex *
+symbol_index_acquire ()
+{
+	CSymbolIndex *index;
 
-			return FALSE;
-		}
+	index = (CSymbolIndex *) g_atomic_pointer_get (&symbol_index);
+	if (index != NULL) {
+		g_atomic_int_inc (&index->ref_count);
 	}
 
-	symbol_clear ();
+	return index;
+}
 
-	while (fgets (line, MAX_LINE_LENGTH, ctags)) {
-		line[strlen (line) - 1] = 0;
-		symbol_parse_line (line);
+static void
+symbol_index_release (CSymbolIndex *index)
+{
+	if (index != NULL && g_atomic_int_dec_and_test (&index->ref_count)) {
+		symbol_index_free (index);
 	}
+}
 
-#ifdef SYMBOL_DEBUG
-	symbol_debug ();
-#endif
+void
+symbol_init ()
+{
+	symbol_index = NULL;
+	symbol_running = FALSE;
 
-	fclose ((gpointer) ctags);
+	symbol_library = NULL;
+	symbol_library_libs = NULL;
+	symbol_library_loading = FALSE;
 
-	ret = system ("cscope -b");
+	symbol_settings_libs = NULL;
+	symbol_settings_project = NULL;
+	symbol_settings_stale = TRUE;
 
-	if (ret != 0) {
-		g_warning ("cscope returned %d.", ret);
+	symbol_files = g_hash_table_new_full (g_str_hash, g_str_equal, g_free, symboldb_file_free);
+	symbol_project = NULL;
+	symbol_tick = 0;
+	symbol_db = NULL;
 
-		return FALSE;
-	}
-	return TRUE;
+	/* One ctags at a time per core. */
+	symbol_pool = g_thread_pool_new (symbol_shard_index, NULL, g_get_num_processors (),
+									 FALSE, NULL);
 }
 
-void
-symbol_function_get_sign (const gchar *name, GList **sign)
+/* Splits data, the tag lines of one file, in place. */
+static gchar **
+symbol_split_tags (gchar *data)
 {
-	GList *iterator;
-
-	for (iterator = function_list; iterator; iterator = iterator->next) {
-		CSymbolFunction *f;
+	gchar **tags;
+	gchar *line;
+	gchar *end;
+	gint n;
+
+	n = 0;
+	for (line = data; (line = strchr (line, '\n')) != NULL; line++) {
+		n++;
+	}
 
-		f = iterator->data;
-		if (g_strcmp0 (f->name, name) == 0) {
-			*sign = g_list_append (*sign, f->sign);
+	tags = g_new (gchar *, n + 2);
+	n = 0;
+	for (line = data; *line; line = end + 1) {
+		tags[n++] = line;
+		end = strchr (line, '\n');
+		if (end == NULL) {
+			break;
 		}
+		*end = 0;
 	}
+	tags[n] = NULL;
+
+	return tags;
 }
 
-static void
-symbol_get_type (const gchar *line, const gchar *name, const gboolean isptr, gchar *type)
+/* Stats and hashes one file, returns TRUE if it needs new tags. Runs in
+ * the pool, so the record of the file is only read. Every file read here
+ * also refreshes its includes in the include graph.
+ */
+static gboolean
+symbol_update_check (CSymbolUpdate *update)
 {
-	gint i, j;
+	const CSymbolFile *file = update->file;
+	GStatBuf st;
+	gchar *content;
+	gsize len;
 
-	i = strlen (line) - 1;
-	while (i >= 0 && !(g_str_has_prefix (line + i, name) && 
-		   !CHAR (line[i - 1]) && !DIGIT (line[i - 1]) &&
-		   !CHAR (line[i + strlen (name)]) && !DIGIT (line[i + strlen (name)]))) {
-		i--;
+	if (g_stat (update->filepath, &st) != 0) {
+		return FALSE;
 	}
+	update->exists = TRUE;
+	update->mtime = st.st_mtime;
+	update->size = st.st_size;
+
+	if (file != NULL && file->mtime == update->mtime && file->size == update->size) {
+		/* Tags from the database still need the includes read once. */
+		if (!incgraph_scanned (update->filepath) &&
+			g_file_get_contents (update->filepath, &content, &len, NULL)) {
+			incgraph_update (update->filepath, content, len);
+			g_free (content);
+		}
 
-	if (i == 0) {
-		type[0] = 0;
+		return FALSE;
+	}
 
-		return;
+	if (!g_file_get_contents (update->filepath, &content, &len, NULL)) {
+		return FALSE;
 	}
+	update->hash = spancache_hash (content, len);
+	incgraph_update (update->filepath, content, len);
 
-	j = i - 1;
-	while (line[j]== ' ') {
-		j--;
+	if (file != NULL && file->hash == update->hash && file->tags != NULL) {
+		update->touched = TRUE;
+		g_free (content);
+
+		return FALSE;
 	}
 
-	if (j >= 0 && ((line[j] != '*' && !isptr) ||
-		(line[j] == '*' && isptr))) {
-		gint k, l;
-		
-		for (j = i - 1; j >= 0; j--)
-			if (line[j] == ' ') {
-				k = j + 1;
-				while (line[k] && line[k] == ' ') {
-					k++;
+	/* The content is at hand, take its references along with the tags. */
+	update->ref_data = xref_scan (content, len);
+	update->refs = symbol_split_tags (update->ref_data);
+	g_free (content);
+
+	return TRUE;
+}
+
+/* Indexes one shard: checks its files and runs a single ctags over those
+ * that changed, then hands their lines back per file.
+ */
+static void
+symbol_shard_index (gpointer data, gpointer user_data)
+{
+	CSymbolShard *shard = (CSymbolShard *) data;
+	GPtrArray *argv;
+	GHashTable *lines;
+	gchar *output;
+	gchar *line;
+	gchar *end;
+	gchar *next;
+	gint status;
+	gint i;
+	gint n_stale;
+	GError *error;
+
+	argv = g_ptr_array_new ();
+	g_ptr_array_add (argv, "ctags");
+	g_ptr_array_add (argv, "-f");
+	g_ptr_array_add (argv, "-");
+	g_ptr_array_add (argv, "--fields=ksStan");
+	g_ptr_array_add (argv, "--c++-kinds=+l");
+	g_ptr_array_add (argv, "--c-kinds=+l");
+	n_stale = 0;
+	for (i = 0; i < shard->n; i++) {
+		if (symbol_update_check (&shard->updates[i])) {
+			shard->updates[i].stale = TRUE;
+			g_ptr_array_add (argv, (gpointer) shard->updates[i].filepath);
+			n_stale++;
+		}
+	}
+	g_ptr_array_add (argv, NULL);
+
+	error = NULL;
+	output = NULL;
+	if (n_stale == 0) {
+		/* Nothing changed in this shard. */
+	}
+	else if (!g_spawn_sync (NULL, (gchar **) argv->pdata, NULL,
+							G_SPAWN_SEARCH_PATH | G_SPAWN_STDERR_TO_DEV_NULL,
+							NULL, NULL, &output, NULL, &status, &error)) {
+		g_warning ("executing ctags failed: %s.", error->message);
+		g_error_free (error);
+	}
+	else if (status != 0) {
+		g_warning ("executing ctags returned %d.", status);
+		g_free (output);
+		output = NULL;
+	}
+	g_ptr_array_free (argv, TRUE);
+
+	if (output != NULL) {
+		/* The second field of a tag line is its file. */
+		lines = g_hash_table_new_full (g_str_hash, g_str_equal, NULL, NULL);
+		for (i = 0; i < shard->n; i++) {
+			if (shard->updates[i].stale) {
+				g_hash_table_insert (lines, (gpointer) shard->updates[i].filepath,
+									 g_string_new (NULL));
+			}
+		}
+
+		for (line = output; *line; line = next) {
+			gchar *file;
+			gchar *file_end;
+			GString *str;
+
+			end = strchr (line, '\n');
+			next = end != NULL? end + 1: line + strlen (line);
+			if (end == NULL) {
+				end = next;
+			}
+			file = memchr (line, '\t', end - line);
+			file_end = file != NULL? memchr (file + 1, '\t', end - file - 1): NULL;
+			if (file_end == NULL) {
+				continue;
+			}
+
+			*file_end = 0;
+			str = (GString *) g_hash_table_lookup (lines, file + 1);
+			*file_end = '\t';
+			if (str != NULL) {
+				g_string_append_len (str, line, end - line);
+				g_string_append_c (str, '\n');
+			}
+		}
+
+		for (i = 0; i < shard->n; i++) {
+			CSymbolUpdate *update = &shard->updates[i];
+
+			if (update->stale) {
+				update->data = g_string_free ((GString *) g_hash_table_lookup (lines, update->filepath),
+											  FALSE);
+				update->tags = symbol_split_tags (update->data);
+			}
+		}
+
+		g_hash_table_destroy (lines);
+		g_free (output);
+	}
+
+	g_mutex_lock (&symbol_pool_mutex);
+	symbol_pool_pending--;
+	g_cond_signal (&symbol_pool_cond);
+	g_mutex_unlock (&symbol_pool_mutex);
+}
+
+/* Takes the result of one file into symbol_files, in project order.
+ * Returns TRUE if its tags changed since the last tick.
+ */
+static gboolean
+symbol_update_apply (CSymbolUpdate *update)
+{
+	CSymbolFile *file;
+
+	file = (CSymbolFile *) update->file;
+	if (!update->exists) {
+		return FALSE;
+	}
+
+	if (file != NULL) {
+		file->tick = symbol_tick;
+		if (update->touched) {
+			file->mtime = update->mtime;
+			file->size = update->size;
+
+			return FALSE;
+		}
+	}
+
+	if (update->tags == NULL) {
+		g_free ((gpointer) update->ref_data);
+		g_free ((gpointer) update->refs);
+
+		return FALSE;
+	}
+
+	if (file == NULL) {
+		file = (CSymbolFile *) g_malloc0 (sizeof (CSymbolFile));
+		g_hash_table_insert (symbol_files, g_strdup (update->filepath), file);
+	}
+	g_free ((gpointer) file->data);
+	g_free ((gpointer) file->tags);
+	g_free ((gpointer) file->ref_data);
+	g_free ((gpointer) file->refs);
+	file->mtime = update->mtime;
+	file->size = update->size;
+	file->hash = update->hash;
+	file->tick = symbol_tick;
+	file->data = update->data;
+	file->tags = update->tags;
+	file->ref_data = update->ref_data;
+	file->refs = update->refs;
+
+	return TRUE;
+}
+
+/* Indexes every project file on the pool, SYMBOL_SHARD_SIZE files per
+ * task, and merges the results in list order whatever order the shards
+ * finish in. Returns TRUE if any file got new tags.
+ */
+static gboolean
+symbol_update_files (CSymbolJob *job)
+{
+	CSymbolUpdate *updates;
+	CSymbolShard *shards;
+	GList *iterator;
+	gboolean changed;
+	gint n_shards;
+	gint n;
+	gint i;
+
+	n = g_list_length (job->header_list) + g_list_length (job->source_list);
+	updates = g_new0 (CSymbolUpdate, n);
+
+	i = 0;
+	for (iterator = job->header_list; iterator; iterator = iterator->next) {
+		updates[i++].filepath = (const gchar *) iterator->data;
+	}
+	for (iterator = job->source_list; iterator; iterator = iterator->next) {
+		updates[i++].filepath = (const gchar *) iterator->data;
+	}
+	for (i = 0; i < n; i++) {
+		updates[i].file = (CSymbolFile *) g_hash_table_lookup (symbol_files, updates[i].filepath);
+	}
+
+	n_shards = (n + SYMBOL_SHARD_SIZE - 1) / SYMBOL_SHARD_SIZE;
+	shards = g_new (CSymbolShard, n_shards);
+
+	g_mutex_lock (&symbol_pool_mutex);
+	symbol_pool_pending = n_shards;
+	g_mutex_unlock (&symbol_pool_mutex);
+
+	for (i = 0; i < n_shards; i++) {
+		shards[i].updates = updates + i * SYMBOL_SHARD_SIZE;
+		shards[i].n = MIN (SYMBOL_SHARD_SIZE, n - i * SYMBOL_SHARD_SIZE);
+		g_thread_pool_push (symbol_pool, (gpointer) &shards[i], NULL);
+	}
+
+	g_mutex_lock (&symbol_pool_mutex);
+	while (symbol_pool_pending > 0) {
+		g_cond_wait (&symbol_pool_cond, &symbol_pool_mutex);
+	}
+	g_mutex_unlock (&symbol_pool_mutex);
+
+	changed = FALSE;
+	for (i = 0; i < n; i++) {
+		changed |= symbol_update_apply (&updates[i]);
+	}
+
+	g_free (shards);
+	g_free (updates);
+
+	return changed;
+}
+
+static gboolean
+symbol_file_stale (gpointer key, gpointer value, gpointer data)
+{
+	CSymbolFile *file = (CSymbolFile *) value;
+
+	if (file->tick != symbol_tick) {
+		incgraph_remove ((const gchar *) key);
+
+		return TRUE;
+	}
+
+	return FALSE;
+}
+
+static void
+symbol_merge_list (CSymbolIndex *index, GList *list)
+{
+	GList *iterator;
+
+	for (iterator = list; iterator; iterator = iterator->next) {
+		CSymbolFile *file;
+		gint i;
+
+		file = (CSymbolFile *) g_hash_table_lookup (symbol_files, iterator->data);
+		if (file == NULL || file->tags == NULL) {
+			continue;
+		}
+
+		for (i = 0; file->tags[i]; i++) {
+			if (!file->tags[i][0] || g_str_has_prefix (file->tags[i], "!_")) {
+				continue;
+			}
+
+			symbol_parse_line (index, file->tags[i], file->tags[i] + strlen (file->tags[i]));
+		}
+	}
+}
+
+static gint
+symbol_reference_line_compare (gconstpointer a, gconstpointer b, gpointer data)
+{
+	return ((const CSymbolReference *) a)->line - ((const CSymbolReference *) b)->line;
+}
+
+/* Adds the uses of defined names in the files of list, each file as one
+ * slice in line order.
+ */
+static void
+symbol_merge_references (CSymbolIndex *index, GList *list, GHashTable *defined)
+{
+	GList *iterator;
+
+	for (iterator = list; iterator; iterator = iterator->next) {
+		CSymbolFile *file;
+		CSymbolRange *range;
+		const gchar *filename;
+		guint start;
+		gint i;
+
+		file = (CSymbolFile *) g_hash_table_lookup (symbol_files, iterator->data);
+		if (file == NULL || file->refs == NULL) {
+			continue;
+		}
+
+		filename = symbol_intern (index, (const gchar *) iterator->data);
+		start = index->references->len;
+		for (i = 0; file->refs[i]; i++) {
+			CSymbolReference reference;
+			const gchar *tab;
+			gchar *p;
+			gchar *next;
+
+			tab = strchr (file->refs[i], '\t');
+			if (tab == NULL) {
+				continue;
+			}
+			reference.name = symbol_intern_find (index, file->refs[i], tab - file->refs[i]);
+			if (reference.name == NULL || !g_hash_table_contains (defined, reference.name)) {
+				continue;
+			}
+			reference.file = filename;
+
+			for (p = (gchar *) tab + 1; *p; p = next) {
+				reference.line = strtol (p, &next, 10);
+				if (next == p) {
+					break;
 				}
-				l = j - 1;
-				while (l >= 0 && line[l] == ' ') {
-					l--;
+				reference.call = *next == 'c';
+				if (reference.call) {
+					next++;
 				}
-				if ((CHAR (line[k]) || line[k] == '*') && (CHAR (line[l]) || DIGIT (line[l]))) {
-					break;
+				while (*next == ' ') {
+					next++;
 				}
+				g_array_append_val (index->references, reference);
 			}
+		}
 
-		if (j < 0) {
-			return;
+		if (index->references->len == start) {
+			continue;
 		}
+		g_qsort_with_data (&g_array_index (index->references, CSymbolReference, start),
+						   index->references->len - start, sizeof (CSymbolReference),
+						   symbol_reference_line_compare, NULL);
+
+		range = (CSymbolRange *) symbol_alloc (index, sizeof (CSymbolRange));
+		range->start = start;
+		range->n = index->references->len - start;
+		g_hash_table_insert (index->reference_files, (gpointer) filename, range);
+	}
+}
+
+static gint
+symbol_reference_name_compare (gconstpointer a, gconstpointer b, gpointer data)
+{
+	const CSymbolReference *references = (const CSymbolReference *) data;
+	guint pa = *(const guint *) a;
+	guint pb = *(const guint *) b;
+	guintptr na = (guintptr) references[pa].name;
+	guintptr nb = (guintptr) references[pb].name;
+
+	if (na != nb) {
+		return na < nb? -1: 1;
+	}
+
+	return pa < pb? -1: pa > pb;
+}
 
-		while (CHAR (line[l]) || DIGIT (line[l])) {
-			l--;
+static gint
+symbol_function_line_compare (gconstpointer a, gconstpointer b, gpointer data)
+{
+	const CSymbolLocation *locations = (const CSymbolLocation *) data;
+
+	return locations[*(const guint *) a].line - locations[*(const guint *) b].line;
+}
+
+/* Builds the reference array and its orders once the tags are in and the
+ * locations sorted: function definitions per file by line, to find the
+ * function around a use, and the uses by name.
+ */
+static void
+symbol_finish_references (CSymbolIndex *index, GList *header_list, GList *source_list)
+{
+	CSymbolLocation *locations;
+	GHashTable *defined;
+	GHashTableIter iter;
+	gpointer value;
+	guint i;
+
+	locations = (CSymbolLocation *) index->locations->data;
+	defined = g_hash_table_new (g_direct_hash, g_direct_equal);
+	for (i = 0; i < index->locations->len; i++) {
+		g_hash_table_add (defined, (gpointer) locations[i].name);
+
+		if (locations[i].kind == 'f') {
+			GArray *functions;
+
+			functions = (GArray *) g_hash_table_lookup (index->function_files, locations[i].file);
+			if (functions == NULL) {
+				functions = g_array_new (FALSE, FALSE, sizeof (guint));
+				g_hash_table_insert (index->function_files, (gpointer) locations[i].file, functions);
+			}
+			g_array_append_val (functions, i);
 		}
-		l++;
-		for (k = 0; CHAR (line[l + k]) || DIGIT (line[l + k]); k++) {
-			type[k] = line[l + k];
+	}
+
+	g_hash_table_iter_init (&iter, index->function_files);
+	while (g_hash_table_iter_next (&iter, NULL, &value)) {
+		GArray *functions = (GArray *) value;
+
+		g_array_sort_with_data (functions, symbol_function_line_compare, locations);
+	}
+
+	symbol_merge_references (index, header_list, defined);
+	symbol_merge_references (index, source_list, defined);
+	g_hash_table_destroy (defined);
+
+	index->reference_order = g_new (guint, index->references->len);
+	for (i = 0; i < index->references->len; i++) {
+		index->reference_order[i] = i;
+	}
+	g_qsort_with_data (index->reference_order, index->references->len, sizeof (guint),
+					   symbol_reference_name_compare, index->references->data);
+
+	index->record_bytes += index->references->len * (sizeof (CSymbolReference) + sizeof (guint));
+}
+
+static gboolean
+symbol_publish_index (gpointer data)
+{
+	CSymbolIndex *old;
+
+	old = (CSymbolIndex *) g_atomic_pointer_get (&symbol_index);
+	g_atomic_pointer_set (&symbol_index, data);
+	symbol_index_release (old);
+
+	return FALSE;
+}
+
+static gboolean
+symbol_publish (gpointer data)
+{
+	CSymbolJob *job = (CSymbolJob *) data;
+
+	/* A job that found nothing new leaves the current snapshot alone. */
+	if (job->index != NULL || job->project_path == NULL) {
+		symbol_publish_index ((gpointer) job->index);
+	}
+
+	g_free (job->project_path);
+	g_list_free_full (job->header_list, g_free);
+	g_list_free_full (job->source_list, g_free);
+	g_free (job);
+
+	symbol_running = FALSE;
+
+	return FALSE;
+}
+
+static CSymbolIndex *
+symbol_index_build (CSymbolJob *job)
+{
+	CSymbolIndex *index;
+	gint64 start;
+	gint64 elapsed;
+
+	start = g_get_monotonic_time ();
+	index = symbol_index_new ();
+	symbol_merge_list (index, job->header_list);
+	symbol_merge_list (index, job->source_list);
+	symbol_finish (index);
+	symbol_finish_references (index, job->header_list, job->source_list);
+	elapsed = MAX (g_get_monotonic_time () - start, 1);
+
+	if (index->tags > 0) {
+		g_debug ("symbol index: %u tags, %u references, %" G_GSIZE_FORMAT " bytes of records, "
+				 "%" G_GSIZE_FORMAT " bytes of strings, %" G_GSIZE_FORMAT " bytes per tag.",
+				 index->tags, index->references->len, index->record_bytes, index->string_bytes,
+				 (index->record_bytes + index->string_bytes) / index->tags);
+		g_debug ("symbol index: parsed %" G_GSIZE_FORMAT " bytes of tags in %" G_GINT64_FORMAT
+				 " us, %.1f MB/s.", index->tag_bytes, elapsed,
+				 (gdouble) index->tag_bytes / elapsed);
+	}
+
+#ifdef SYMBOL_DEBUG
+	symbol_debug (index);
+#endif
+
+	return index;
+}
+
+static gpointer
+symbol_index_job (gpointer data)
+{
+	CSymbolJob *job = (CSymbolJob *) data;
+	gboolean changed;
+	guint removed;
+
+	if (g_strcmp0 (job->project_path, symbol_project) != 0) {
+		g_hash_table_remove_all (symbol_files);
+		if (symbol_db != NULL) {
+			g_mapped_file_unref (symbol_db);
+			symbol_db = NULL;
+		}
+		g_free (symbol_project);
+		symbol_project = g_strdup (job->project_path);
+		incgraph_reset (job->project_path);
+
+		/* Serve the tags of the last session right away, the files are
+		 * checked against them below.
+		 */
+		if (job->project_path != NULL) {
+			symbol_db = symboldb_load (job->project_path, symbol_files);
+			if (g_hash_table_size (symbol_files) > 0) {
+				g_idle_add (symbol_publish_index, (gpointer) symbol_index_build (job));
+			}
+		}
+	}
+
+	if (job->project_path == NULL) {
+		g_idle_add (symbol_publish, data);
+
+		return NULL;
+	}
+
+	symbol_tick++;
+	changed = symbol_update_files (job);
+	removed = g_hash_table_foreach_remove (symbol_files, symbol_file_stale, NULL);
+
+	/* Nothing to do until a project file is edited, added or removed. */
+	if (!changed && removed == 0) {
+		g_idle_add (symbol_publish, data);
+
+		return NULL;
+	}
+
+	job->index = symbol_index_build (job);
+	symboldb_save (job->project_path, job->header_list, job->source_list, symbol_files);
+
+	g_idle_add (symbol_publish, data);
+
+	return NULL;
+}
+
+gboolean 
+symbol_parse (gpointer data)
+{
+	CSymbolJob *job;
+	gchar *project_path;
+	GList *header_list;
+	GList *source_list;
+	GList *resource_list;
+
+	if (!env_prog_exist (ENV_PROG_CTAGS)) {
+		g_warning ("ctags not found.");
+
+		return FALSE;
+	}
+
+	/* The previous run has not been published yet. */
+	if (symbol_running) {
+		return TRUE;
+	}
+
+	project_path = project_current_path ();
+	if (project_path == NULL && symbol_project == NULL) {
+		return TRUE;
+	}
+
+	/* The project lists belong to the main loop, the job gets copies. */
+	project_get_file_lists (&header_list, &source_list, &resource_list);
+
+	job = (CSymbolJob *) g_malloc0 (sizeof (CSymbolJob));
+	job->project_path = g_strdup (project_path);
+	job->header_list = g_list_copy_deep (header_list, (GCopyFunc) g_strdup, NULL);
+	job->source_list = g_list_copy_deep (source_list, (GCopyFunc) g_strdup, NULL);
+	job->index = NULL;
+
+	symbol_running = TRUE;
+	g_thread_unref (g_thread_new ("symbol", symbol_index_job, (gpointer) job));
+
+	return TRUE;
+}
+
+static gboolean
+symbol_library_publish (gpointer data)
+{
+	CSymbolLibraryJob *job = (CSymbolLibraryJob *) data;
+	CSymbolIndex *old;
+
+	/* The settings changed while loading, the next lookup starts over. */
+	if (g_strcmp0 (job->libs, symbol_library_libs) == 0) {
+		old = (CSymbolIndex *) g_atomic_pointer_get (&symbol_library);
+		g_atomic_pointer_set (&symbol_library, job->index);
+		symbol_index_release (old);
+	}
+	else {
+		symbol_index_release (job->index);
+	}
+
+	g_free ((gpointer) job->libs);
+	g_free (job);
+
+	symbol_library_loading = FALSE;
+
+	return FALSE;
+}
+
+static gpointer
+symbol_library_job (gpointer data)
+{
+	CSymbolLibraryJob *job = (CSymbolLibraryJob *) data;
+	GList *maps;
+	GList *iterator;
+	gint64 start;
+
+	start = g_get_monotonic_time ();
+	maps = libindex_load (job->libs);
+
+	job->index = symbol_index_new ();
+	for (iterator = maps; iterator; iterator = iterator->next) {
+		const gchar *line;
+		const gchar *end;
+		const gchar *limit;
+
+		line = g_mapped_file_get_contents ((GMappedFile *) iterator->data);
+		limit = line + g_mapped_file_get_length ((GMappedFile *) iterator->data);
+		for (; line < limit; line = end + 1) {
+			end = memchr (line, '\n', limit - line);
+			if (end == NULL) {
+				end = limit;
+			}
+			if (end == line || (line[0] == '!' && line[1] == '_')) {
+				continue;
+			}
+
+			symbol_parse_line (job->index, line, end);
 		}
-		type[k] = 0;
 	}
+	symbol_finish (job->index);
+	g_list_free_full (maps, (GDestroyNotify) g_mapped_file_unref);
+
+	g_debug ("library index: %u tags for \"%s\" in %" G_GINT64_FORMAT " us.",
+			 job->index->tags, job->libs, g_get_monotonic_time () - start);
+
+	g_idle_add (symbol_library_publish, data);
+
+	return NULL;
+}
+
+/* The project settings were saved, their libs may differ now. */
+void
+symbol_settings_changed ()
+{
+	symbol_settings_stale = TRUE;
+}
+
+static const gchar *
+symbol_settings_get_libs ()
+{
+	gchar libs[MAX_OPTION_LENGTH + 1];
+	gchar opts[MAX_OPTION_LENGTH + 1];
+	const gchar *project_path;
+
+	project_path = project_current_path ();
+	if (symbol_settings_stale || g_strcmp0 (project_path, symbol_settings_project) != 0) {
+		project_get_settings (libs, MAX_OPTION_LENGTH, opts, MAX_OPTION_LENGTH);
+
+		g_free ((gpointer) symbol_settings_libs);
+		symbol_settings_libs = g_strdup (libs);
+		g_free ((gpointer) symbol_settings_project);
+		symbol_settings_project = g_strdup (project_path);
+		symbol_settings_stale = FALSE;
+	}
+
+	return symbol_settings_libs;
+}
+
+/* Like symbol_index_acquire for the library headers. The first lookup
+ * after the project's libs change starts loading them in the background
+ * and gets the previous index, if any, meanwhile.
+ */
+static CSymbolIndex *
+symbol_library_acquire ()
+{
+	const gchar *libs;
+	CSymbolIndex *index;
+
+	libs = symbol_settings_get_libs ();
+	if (!symbol_library_loading && g_strcmp0 (libs, symbol_library_libs) != 0) {
+		CSymbolLibraryJob *job;
+
+		g_free ((gpointer) symbol_library_libs);
+		symbol_library_libs = g_strdup (libs);
+
+		job = (CSymbolLibraryJob *) g_malloc0 (sizeof (CSymbolLibraryJob));
+		job->libs = g_strdup (libs);
+		symbol_library_loading = TRUE;
+		g_thread_unref (g_thread_new ("library", symbol_library_job, (gpointer) job));
+	}
+
+	index = (CSymbolIndex *) g_atomic_pointer_get (&symbol_library);
+	if (index != NULL) {
+		g_atomic_int_inc (&index->ref_count);
+	}
+
+	return index;
 }
 
 static void
-symbol_get_member_from_type (const gchar *type, GList **funs, GList **vars)
+symbol_function_get_sign_from (CSymbolIndex *index, const gchar *name, GList **sign)
+{
+	GList *iterator;
+
+	if (index == NULL) {
+		return;
+	}
+
+	iterator = (GList *) g_hash_table_lookup (index->function_table, name);
+	for (; iterator; iterator = iterator->next) {
+		CSymbolFunction *f;
+
+		f = iterator->data;
+		*sign = g_list_append (*sign, (gpointer) f->sign);
+	}
+
+	symbol_index_release (index);
+}
+
+void
+symbol_function_get_sign (const gchar *name, GList **sign)
+{
+	symbol_function_get_sign_from (symbol_index_acquire (), name, sign);
+
+	/* Only names the project does not define come from the libraries. */
+	if (*sign == NULL) {
+		symbol_function_get_sign_from (symbol_library_acquire (), name, sign);
+	}
+}
+
+static void
+symbol_get_member_from_type (CSymbolIndex *index, const gchar *type, GList **funs, GList **vars)
 {
 	CSymbolClass *class_ptr;
 	CSymbolStruct *struct_ptr;
 
-	class_ptr = symbol_find_class (type);
+	class_ptr = symbol_find_class (index, type);
 	if (class_ptr != NULL) {
 		GList *iterator;
 
@@ -756,17 +1726,17 @@ symbol_get_member_from_type (const gchar *type, GList **funs, GList **vars)
 			CSymbolVariable *v;
 
 			v = iterator->data;
-			(*vars) = g_list_append (*vars, v->name);
+			(*vars) = g_list_append (*vars, (gpointer) v->name);
 		}
 		for (iterator = class_ptr->public_function_list; iterator; iterator = iterator->next) {
 			CSymbolFunction *f;
 
 			f = iterator->data;
-			(*funs) = g_list_append (*funs, f->name);
+			(*funs) = g_list_append (*funs, (gpointer) f->name);
 		}
 	}
 
-	struct_ptr = symbol_find_struct (type);
+	struct_ptr = symbol_find_struct (index, type);
 	if (struct_ptr != NULL) {
 		GList *iterator;
 
@@ -774,13 +1744,13 @@ symbol_get_member_from_type (const gchar *type, GList **funs, GList **vars)
 			CSymbolVariable *v;
 
 			v = iterator->data;
-			(*vars) = g_list_append (*vars, v->name);
+			(*vars) = g_list_append (*vars, (gpointer) v->name);
 		}
 		for (iterator = struct_ptr->function_list; iterator; iterator = iterator->next) {
 			CSymbolFunction *f;
 
 			f = iterator->data;
-			(*funs) = g_list_append (*funs, f->name);
+			(*funs) = g_list_append (*funs, (gpointer) f->name);
 		}
 	}
 }
@@ -788,100 +1758,587 @@ symbol_get_member_from_type (const gchar *type, GList **funs, GList **vars)
 void
 symbol_variable_get_member (const gchar *name, const gint lineno, const gboolean isptr, GList **funs, GList **vars)
 {
-	gchar command[MAX_COMMAND_LENGTH + 1];
-	gchar filepath[MAX_FILEPATH_LENGTH + 1];
-	gchar *project_path;
-	gchar *output;
-	gchar last_line[MAX_LINE_LENGTH + 1];
-	FILE *pipe_file;
 	gchar type[MAX_TYPENAME_LENGTH + 1];
+	CSymbolIndex *index;
 
-	project_path = project_current_path ();
+	/* The receiver's type comes from the declarations in the buffer. */
+	if (!ui_current_editor_local_type (name, lineno, isptr, type, MAX_TYPENAME_LENGTH)) {
+		return;
+	}
+
+	index = symbol_index_acquire ();
+	if (index != NULL) {
+		symbol_get_member_from_type (index, type, funs, vars);
+		symbol_index_release (index);
+	}
+
+	if (*funs == NULL && *vars == NULL) {
+		index = symbol_library_acquire ();
+		if (index != NULL) {
+			symbol_get_member_from_type (index, type, funs, vars);
+			symbol_index_release (index);
+		}
+	}
+}
 
-	if (project_path == NULL) {
+static void
+symbol_namespace_get_member_from (CSymbolIndex *index, const gchar *name, GList **funs, GList **vars)
+{
+	CSymbolNamespace *namespace_ptr;
+
+	if (index == NULL) {
 		return;
 	}
-	
-	output = (gchar *) g_malloc (MAX_RESULT_LENGTH + 1);
 
-	if (ui_have_editor ()) {
-		const gchar *code;
+	namespace_ptr = symbol_find_namespace (index, name);
+	if (namespace_ptr != NULL) {
+		GList *iterator;
+
+		for (iterator = namespace_ptr->member_list; iterator; iterator = iterator->next) {
+			CSymbolVariable *v;
+
+			v = iterator->data;
+			(*vars) = g_list_append (*vars, (gpointer) v->name);
+		}
+		for (iterator = namespace_ptr->function_list; iterator; iterator = iterator->next) {
+			CSymbolFunction *f;
+
+			f = iterator->data;
+			(*funs) = g_list_append (*funs, (gpointer) f->name);
+		}
+	}
 
-		code = ui_current_editor_code ();
+	symbol_index_release (index);
+}
 
-		if (code != NULL) {
-			g_snprintf (filepath, MAX_FILEPATH_LENGTH, "%s/.symbol.%s",
-						project_path,
-						project_get_type () == PROJECT_C? "c": "cpp");
+void
+symbol_namespace_get_member (const gchar *name, GList **funs, GList **vars)
+{
+	symbol_namespace_get_member_from (symbol_index_acquire (), name, funs, vars);
+	if (*funs == NULL && *vars == NULL) {
+		symbol_namespace_get_member_from (symbol_library_acquire (), name, funs, vars);
+	}
+}
 
-			misc_set_file_content (filepath, code);
+static CSymbolMatch *
+symbol_match_new (const gchar *name, const gchar *scope, const gchar *filepath,
+				  const gint line, const gchar kind)
+{
+	CSymbolMatch *match;
+
+	match = (CSymbolMatch *) g_malloc (sizeof (CSymbolMatch));
+	match->name = g_strdup (name);
+	match->scope = g_strdup (scope);
+	match->filepath = g_strdup (filepath);
+	match->line = line;
+	match->kind = kind;
+
+	return match;
+}
+
+/* Search ranks, higher is better. A fuzzy hit always ranks below any
+ * prefix hit, however tight it is.
+ */
+#define SYMBOL_RANK_EXACT 1000
+#define SYMBOL_RANK_EXACT_NOCASE 900
+#define SYMBOL_RANK_PREFIX 800
+#define SYMBOL_RANK_PREFIX_NOCASE 700
+#define SYMBOL_RANK_FUZZY 600
+
+typedef struct {
+	gint rank;
+	guint pos;
+} CSymbolHit;
+
+/* Hit a is worse than hit b: lower rank, then longer name, then later
+ * in name order.
+ */
+static gboolean
+symbol_hit_worse (GArray *locations, const CSymbolHit *a, const CSymbolHit *b)
+{
+	const CSymbolLocation *la;
+	const CSymbolLocation *lb;
+	gint len_a;
+	gint len_b;
+
+	if (a->rank != b->rank) {
+		return a->rank < b->rank;
+	}
+
+	la = &g_array_index (locations, CSymbolLocation, a->pos);
+	lb = &g_array_index (locations, CSymbolLocation, b->pos);
+	len_a = strlen (la->name);
+	len_b = strlen (lb->name);
+	if (len_a != len_b) {
+		return len_a > len_b;
+	}
+
+	return a->pos > b->pos;
+}
+
+static gint
+symbol_hit_compare (gconstpointer a, gconstpointer b, gpointer data)
+{
+	if (symbol_hit_worse ((GArray *) data, (const CSymbolHit *) a, (const CSymbolHit *) b)) {
+		return 1;
+	}
+	if (symbol_hit_worse ((GArray *) data, (const CSymbolHit *) b, (const CSymbolHit *) a)) {
+		return -1;
+	}
 
-			g_free ((gpointer) code);
+	return 0;
+}
+
+/* Keeps the best hits in a min-heap of at most limit entries, so a query
+ * matching half of the project costs no more than the walk itself.
+ */
+static void
+symbol_hit_offer (GArray *heap, GArray *locations, const gint limit, CSymbolHit hit)
+{
+	CSymbolHit *hits;
+	guint i;
+
+	if (heap->len < (guint) limit) {
+		g_array_append_val (heap, hit);
+		hits = (CSymbolHit *) heap->data;
+		for (i = heap->len - 1; i > 0; i = (i - 1) / 2) {
+			CSymbolHit tmp;
+
+			if (!symbol_hit_worse (locations, &hits[i], &hits[(i - 1) / 2])) {
+				break;
+			}
+			tmp = hits[i];
+			hits[i] = hits[(i - 1) / 2];
+			hits[(i - 1) / 2] = tmp;
 		}
+
+		return;
 	}
 
-	g_snprintf (command, MAX_LINE_LENGTH, "cscope -L0 %s %s", name, filepath);
+	hits = (CSymbolHit *) heap->data;
+	if (!symbol_hit_worse (locations, &hits[0], &hit)) {
+		return;
+	}
 
-	pipe_file = popen (command, "r");
-	last_line[0] = 0;
-	type[0] = 0;
-	while (fgets (output, MAX_LINE_LENGTH, pipe_file)) {
-		gint i;
-		gint symbol_lineno;
+	hits[0] = hit;
+	i = 0;
+	for (;;) {
+		guint child;
+		CSymbolHit tmp;
 
-		i = 0;
+		child = 2 * i + 1;
+		if (child >= heap->len) {
+			break;
+		}
+		if (child + 1 < heap->len &&
+			symbol_hit_worse (locations, &hits[child + 1], &hits[child])) {
+			child++;
+		}
+		if (!symbol_hit_worse (locations, &hits[child], &hits[i])) {
+			break;
+		}
+		tmp = hits[i];
+		hits[i] = hits[child];
+		hits[child] = tmp;
+		i = child;
+	}
+}
 
-		while (output[i] != ' ') {
-			i++;
+/* Scores key as a subsequence of the lowercased query, 0 if it is not
+ * one. Gaps cost, letters at word starts in the name earn.
+ */
+static gint
+symbol_fuzzy_rank (const gchar *key, const gchar *name, const gchar *query)
+{
+	const gchar *q;
+	gint rank;
+	gint i;
+	gint last;
+
+	rank = SYMBOL_RANK_FUZZY;
+	last = -1;
+	q = query;
+	for (i = 0; key[i] != '\0' && *q != '\0'; i++) {
+		if (key[i] != *q) {
+			continue;
 		}
-		i++;
-		while (output[i] != ' ') {
-			i++;
+
+		if (i == 0 || name[i - 1] == '_' ||
+			(g_ascii_isupper (name[i]) && g_ascii_islower (name[i - 1]))) {
+			rank += 10;
 		}
-		i++;
+		if (last >= 0) {
+			rank -= MIN (i - last - 1, 20);
+		}
+		last = i;
+		q++;
+	}
 
-		sscanf (output + i, "%d", &symbol_lineno);
-		if (symbol_lineno >= lineno) {
-			break;
+	if (*q != '\0') {
+		return 0;
+	}
+
+	return CLAMP (rank, 1, SYMBOL_RANK_PREFIX_NOCASE - 1);
+}
+
+/* Looks up the whole project by name: prefix hits first, then names
+ * holding the query as a subsequence, at most limit of them, best first.
+ */
+GList *
+symbol_search (const gchar *query, const gint limit)
+{
+	CSymbolIndex *index;
+	CSymbolLocation *locations;
+	GArray *heap;
+	GList *result;
+	gchar *key;
+	gint key_len;
+	guint n;
+	guint low;
+	guint high;
+	guint i;
+
+	if (query == NULL || query[0] == '\0' || limit <= 0) {
+		return NULL;
+	}
+
+	index = symbol_index_acquire ();
+	if (index == NULL) {
+		return NULL;
+	}
+
+	key = g_ascii_strdown (query, -1);
+	key_len = strlen (key);
+	locations = (CSymbolLocation *) index->locations->data;
+	n = index->locations->len;
+	heap = g_array_sized_new (FALSE, FALSE, sizeof (CSymbolHit), limit);
+
+	low = 0;
+	high = n;
+	while (low < high) {
+		guint mid = low + (high - low) / 2;
+
+		if (strcmp (locations[mid].key, key) < 0) {
+			low = mid + 1;
 		}
+		else {
+			high = mid;
+		}
+	}
 
-		while (output[i] != ' ') {
-			i++;
+	for (i = low; i < n && strncmp (locations[i].key, key, key_len) == 0; i++) {
+		CSymbolHit hit;
+		gboolean exact;
+
+		exact = locations[i].key[key_len] == '\0';
+		if (strncmp (locations[i].name, query, key_len) == 0) {
+			hit.rank = exact? SYMBOL_RANK_EXACT: SYMBOL_RANK_PREFIX;
+		}
+		else {
+			hit.rank = exact? SYMBOL_RANK_EXACT_NOCASE: SYMBOL_RANK_PREFIX_NOCASE;
 		}
-		i++;
-		g_strlcpy (last_line, output + i, MAX_LINE_LENGTH);
-		last_line[strlen (last_line) - 1] = 0;
+		hit.pos = i;
+		symbol_hit_offer (heap, index->locations, limit, hit);
+	}
+	high = i;
+
+	/* A single letter is a prefix, as a subsequence it matches everything. */
+	if (key_len > 1) {
+		const gchar *last_name;
+		gint last_rank;
+
+		last_name = NULL;
+		last_rank = 0;
+		for (i = 0; i < n; i++) {
+			CSymbolHit hit;
+
+			if (i == low) {
+				i = high;
+				if (i >= n) {
+					break;
+				}
+			}
 
-		symbol_get_type (last_line, name, isptr, type);
+			/* Overloads and redeclarations sit next to each other. */
+			if (locations[i].name != last_name) {
+				last_name = locations[i].name;
+				last_rank = symbol_fuzzy_rank (locations[i].key, last_name, key);
+			}
+			if (last_rank == 0) {
+				continue;
+			}
+
+			hit.rank = last_rank;
+			hit.pos = i;
+			symbol_hit_offer (heap, index->locations, limit, hit);
+		}
 	}
 
-	if (type[0]) { 
-		symbol_get_member_from_type (type, funs, vars);
+	g_array_sort_with_data (heap, symbol_hit_compare, index->locations);
+
+	result = NULL;
+	for (i = heap->len; i > 0; i--) {
+		CSymbolHit *hit;
+		CSymbolLocation *location;
+		CSymbolMatch *match;
+
+		hit = &g_array_index (heap, CSymbolHit, i - 1);
+		location = &locations[hit->pos];
+		match = symbol_match_new (location->name, location->scope, location->file,
+								  location->line, location->kind);
+		result = g_list_prepend (result, match);
 	}
 
-	g_free ((gpointer) output);
+	g_array_free (heap, TRUE);
+	g_free (key);
+	symbol_index_release (index);
+
+	return result;
 }
 
 void
-symbol_namespace_get_member (const gchar *name, GList **funs, GList **vars)
+symbol_match_free (gpointer data)
 {
-	CSymbolNamespace *namespace_ptr;
+	CSymbolMatch *match;
 
-	namespace_ptr = symbol_find_namespace (name);
-	if (namespace_ptr != NULL) {
-		GList *iterator;
+	match = (CSymbolMatch *) data;
+	g_free (match->name);
+	g_free (match->scope);
+	g_free (match->filepath);
+	g_free (match);
+}
 
-		for (iterator = namespace_ptr->member_list; iterator; iterator = iterator->next) {
-			CSymbolVariable *v;
+/* The function defined last before line in file, NULL at file scope. */
+static const CSymbolLocation *
+symbol_enclosing_function (CSymbolIndex *index, const gchar *file, const gint line)
+{
+	CSymbolLocation *locations;
+	GArray *functions;
+	guint low;
+	guint high;
+
+	functions = (GArray *) g_hash_table_lookup (index->function_files, file);
+	if (functions == NULL) {
+		return NULL;
+	}
 
-			v = iterator->data;
-			(*vars) = g_list_append (*vars, v->name);
+	locations = (CSymbolLocation *) index->locations->data;
+	low = 0;
+	high = functions->len;
+	while (low < high) {
+		guint mid = low + (high - low) / 2;
+
+		if (locations[g_array_index (functions, guint, mid)].line <= line) {
+			low = mid + 1;
 		}
-		for (iterator = namespace_ptr->function_list; iterator; iterator = iterator->next) {
-			CSymbolFunction *f;
+		else {
+			high = mid;
+		}
+	}
 
-			f = iterator->data;
-			(*funs) = g_list_append (*funs, f->name);
+	return low > 0? &locations[g_array_index (functions, guint, low - 1)]: NULL;
+}
+
+/* Positions in the location array of every tag named name. */
+static void
+symbol_location_range (CSymbolIndex *index, const gchar *name, guint *start, guint *end)
+{
+	CSymbolLocation *locations;
+	gchar *key;
+	guint low;
+	guint high;
+
+	locations = (CSymbolLocation *) index->locations->data;
+	key = g_ascii_strdown (name, -1);
+	low = 0;
+	high = index->locations->len;
+	while (low < high) {
+		guint mid = low + (high - low) / 2;
+
+		if (strcmp (locations[mid].key, key) < 0) {
+			low = mid + 1;
+		}
+		else {
+			high = mid;
+		}
+	}
+	*start = low;
+	while (low < index->locations->len && strcmp (locations[low].key, key) == 0) {
+		low++;
+	}
+	*end = low;
+
+	g_free (key);
+}
+
+/* Whether the use of name at file:line is one of its own tags, the
+ * definition or a prototype rather than a call.
+ */
+static gboolean
+symbol_is_declaration (CSymbolIndex *index, const gchar *name, const gchar *file, const gint line)
+{
+	CSymbolLocation *locations;
+	guint start;
+	guint end;
+
+	locations = (CSymbolLocation *) index->locations->data;
+	symbol_location_range (index, name, &start, &end);
+	for (; start < end; start++) {
+		if (locations[start].name == name && locations[start].file == file &&
+			locations[start].line == line) {
+			return TRUE;
 		}
 	}
+
+	return FALSE;
+}
+
+static GList *
+symbol_xref_uses (CSymbolIndex *index, const gchar *name, const gboolean calls)
+{
+	CSymbolReference *references;
+	GList *result;
+	guint low;
+	guint high;
+
+	references = (CSymbolReference *) index->references->data;
+	low = 0;
+	high = index->references->len;
+	while (low < high) {
+		guint mid = low + (high - low) / 2;
+
+		if ((guintptr) references[index->reference_order[mid]].name < (guintptr) name) {
+			low = mid + 1;
+		}
+		else {
+			high = mid;
+		}
+	}
+
+	result = NULL;
+	for (; low < index->references->len; low++) {
+		const CSymbolReference *reference;
+		const CSymbolLocation *function;
+
+		reference = &references[index->reference_order[low]];
+		if (reference->name != name) {
+			break;
+		}
+		if (calls && (!reference->call ||
+					  symbol_is_declaration (index, name, reference->file, reference->line))) {
+			continue;
+		}
+
+		function = symbol_enclosing_function (index, reference->file, reference->line);
+		result = g_list_prepend (result,
+								 symbol_match_new (function != NULL? function->name: "",
+												   function != NULL? function->scope: NULL,
+												   reference->file, reference->line,
+												   reference->call? 'c': 'r'));
+	}
+
+	return g_list_reverse (result);
+}
+
+static GList *
+symbol_xref_callees (CSymbolIndex *index, const gchar *name)
+{
+	CSymbolLocation *locations;
+	CSymbolReference *references;
+	GList *result;
+	guint start;
+	guint end;
+
+	locations = (CSymbolLocation *) index->locations->data;
+	references = (CSymbolReference *) index->references->data;
+	symbol_location_range (index, name, &start, &end);
+
+	result = NULL;
+	for (; start < end; start++) {
+		const CSymbolLocation *location;
+		const CSymbolRange *range;
+		GArray *functions;
+		gint last;
+		guint i;
+
+		location = &locations[start];
+		if (location->name != name || location->kind != 'f') {
+			continue;
+		}
+
+		range = (const CSymbolRange *) g_hash_table_lookup (index->reference_files, location->file);
+		if (range == NULL) {
+			continue;
+		}
+
+		/* The body runs up to the next definition in the file. */
+		last = G_MAXINT;
+		functions = (GArray *) g_hash_table_lookup (index->function_files, location->file);
+		for (i = 0; i < functions->len; i++) {
+			const CSymbolLocation *next;
+
+			next = &locations[g_array_index (functions, guint, i)];
+			if (next->line > location->line) {
+				last = next->line;
+				break;
+			}
+		}
+
+		for (i = range->start; i < range->start + range->n; i++) {
+			const CSymbolReference *reference = &references[i];
+
+			if (reference->line < location->line || reference->line >= last) {
+				continue;
+			}
+			if (!reference->call ||
+				symbol_is_declaration (index, reference->name, reference->file, reference->line)) {
+				continue;
+			}
+
+			result = g_list_prepend (result,
+									 symbol_match_new (reference->name, NULL, reference->file,
+													   reference->line, 'c'));
+		}
+	}
+
+	return g_list_reverse (result);
+}
+
+/* Answers a cross reference query on name from the current snapshot:
+ * every use of it, the calls to it with the function making them, or the
+ * calls made from its body.
+ */
+GList *
+symbol_xref (const gchar *name, const CSymbolXref xref)
+{
+	CSymbolIndex *index;
+	const gchar *interned;
+	GList *result;
+
+	index = symbol_index_acquire ();
+	if (index == NULL) {
+		return NULL;
+	}
+
+	result = NULL;
+	interned = symbol_intern_find (index, name, strlen (name));
+	if (interned != NULL) {
+		switch (xref) {
+		case SYMBOL_XREF_REFERENCES:
+			result = symbol_xref_uses (index, interned, FALSE);
+			break;
+
+		case SYMBOL_XREF_CALLERS:
+			result = symbol_xref_uses (index, interned, TRUE);
+			break;
+
+		case SYMBOL_XREF_CALLEES:
+			result = symbol_xref_callees (index, interned);
+			break;
+		}
+	}
+
+	symbol_index_release (index);
+
+	return result;
 }
@@ -27,7 +27,6 @@
 
 #define MAX_TYPENAME_LENGTH 255
 #define MAX_VARNAME_LENGTH 255
-#define MAX_SIGN_LENGTH 2550
 
 typedef enum {
 	META_TYPE_BASE,
@@ -44,37 +43,52 @@ typedef struct {
 
 typedef struct {
 	CMetaType metaclass;
-	gchar name[MAX_TYPENAME_LENGTH + 1];
+	const gchar *name;
 	GList *public_member_list;
 	GList *public_function_list;
 } CSymbolClass;
 
 typedef struct {
 	CMetaType metaclass;
-	gchar name[MAX_TYPENAME_LENGTH + 1];
+	const gchar *name;
 	GList *member_list;
 	GList *function_list;
 } CSymbolStruct;
 	
 typedef struct {
 	CMetaType metaclass;
-	gchar name[MAX_TYPENAME_LENGTH + 1];
+	const gchar *name;
 	GList *member_list;
 	GList *function_list;
 } CSymbolNamespace;
 
 typedef struct {
 	CMetaType metaclass;
-	gchar name[MAX_TYPENAME_LENGTH + 1];
-	gchar sign[MAX_SIGN_LENGTH + 1];
+	const gchar *name;
+	const gchar *sign;
 } CSymbolFunction;
 
 typedef struct {
 	CMetaType metaclass;
-	gchar type[MAX_TYPENAME_LENGTH + 1];
-	gchar name[MAX_VARNAME_LENGTH + 1];
+	const gchar *type;
+	const gchar *name;
 } CSymbolVariable;
 
+/* One hit of a workspace symbol search, owned by the caller. */
+typedef struct {
+	gchar *name;
+	gchar *scope;
+	gchar *filepath;
+	gint line;
+	gchar kind;
+} CSymbolMatch;
+
+typedef enum {
+	SYMBOL_XREF_REFERENCES,
+	SYMBOL_XREF_CALLERS,
+	SYMBOL_XREF_CALLEES
+} CSymbolXref;
+
 gboolean 
 symbol_parse (gpointer data);
 
@@ -90,4 +104,16 @@ symbol_variable_get_member (const gchar *name, const gint lineno, const gboolean
 void
 symbol_namespace_get_member (const gchar *name, GList **funs, GList **vars);
 
+GList *
+symbol_search (const gchar *query, const gint limit);
+
+void
+symbol_match_free (gpointer data);
+
+GList *
+symbol_xref (const gchar *name, const CSymbolXref xref);
+
+void
+symbol_settings_changed ();
+
 #endif /* SYMBOL_H */
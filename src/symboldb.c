@@ -0,0 +1,247 @@
+/*
+ * symboldb.c
+ * This file is part of codefox
+ *
+ * Copyright (C) 2012-2017 - Gordon Li
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <gtk/gtk.h>
+#include <string.h>
+
+#include "symboldb.h"
+
+/* "CFSD" */
+#define SYMBOLDB_MAGIC 0x44534643
+#define SYMBOLDB_VERSION 3
+
+#define SYMBOLDB_FILE "project.cfs"
+
+/* Layout of the database: the header, a table of files, and then the nul
+ * terminated strings the table points to by offset from the start. Each
+ * file's tag lines follow each other, and so do its reference lines, so
+ * the whole file can be mapped and its lines used in place. Integers are
+ * in host byte order.
+ */
+typedef struct {
+	guint32 magic;
+	guint32 version;
+	guint32 files;
+	guint32 reserved;
+} CSymbolDbHeader;
+
+typedef struct {
+	guint64 hash;
+	gint64 mtime;
+	gint64 size;
+	guint32 path;
+	guint32 tags;
+	guint32 n_tags;
+	guint32 refs;
+	guint32 n_refs;
+	guint32 reserved;
+} CSymbolDbFile;
+
+void
+symboldb_file_free (gpointer ptr)
+{
+	CSymbolFile *file = (CSymbolFile *) ptr;
+
+	g_free ((gpointer) file->data);
+	g_free ((gpointer) file->tags);
+	g_free ((gpointer) file->ref_data);
+	g_free ((gpointer) file->refs);
+	g_free (ptr);
+}
+
+/* Points n lines, starting at offset in the map, into a NULL ended array. */
+static gchar **
+symboldb_lines (const gchar *content, const gsize len, const guint32 offset, const guint32 n)
+{
+	gchar **lines;
+	const gchar *line;
+	guint32 i;
+
+	lines = g_new (gchar *, n + 1);
+	line = content + offset;
+	for (i = 0; i < n && line < content + len; i++) {
+		lines[i] = (gchar *) line;
+		line += strlen (line) + 1;
+	}
+	lines[i] = NULL;
+
+	return lines;
+}
+
+static gchar *
+symboldb_path (const gchar *project_path)
+{
+	return g_build_filename (project_path, SYMBOLDB_FILE, NULL);
+}
+
+/* Restores the files recorded for project_path into files, keyed by path.
+ * Their tags point into the returned map, which must outlive them.
+ */
+GMappedFile *
+symboldb_load (const gchar *project_path, GHashTable *files)
+{
+	GMappedFile *map;
+	CSymbolDbHeader header;
+	const gchar *content;
+	gsize len;
+	gchar *path;
+	guint32 i;
+
+	path = symboldb_path (project_path);
+	map = g_mapped_file_new (path, FALSE, NULL);
+	g_free ((gpointer) path);
+
+	if (map == NULL) {
+		return NULL;
+	}
+
+	content = g_mapped_file_get_contents (map);
+	len = g_mapped_file_get_length (map);
+
+	/* The last byte is a nul, so any string inside the map ends in it. */
+	if (len < sizeof (CSymbolDbHeader) || content[len - 1] != 0) {
+		g_mapped_file_unref (map);
+
+		return NULL;
+	}
+	memcpy (&header, content, sizeof (CSymbolDbHeader));
+	if (header.magic != SYMBOLDB_MAGIC || header.version != SYMBOLDB_VERSION ||
+		header.files > (len - sizeof (CSymbolDbHeader)) / sizeof (CSymbolDbFile)) {
+		g_mapped_file_unref (map);
+
+		return NULL;
+	}
+
+	for (i = 0; i < header.files; i++) {
+		CSymbolDbFile record;
+		CSymbolFile *file;
+
+		memcpy (&record, content + sizeof (CSymbolDbHeader) + i * sizeof (CSymbolDbFile),
+				sizeof (CSymbolDbFile));
+		if (record.path >= len || record.tags >= len || record.refs >= len) {
+			break;
+		}
+
+		file = (CSymbolFile *) g_malloc (sizeof (CSymbolFile));
+		file->mtime = record.mtime;
+		file->size = record.size;
+		file->hash = record.hash;
+		file->tick = 0;
+		file->data = NULL;
+		file->tags = symboldb_lines (content, len, record.tags, record.n_tags);
+		file->ref_data = NULL;
+		file->refs = symboldb_lines (content, len, record.refs, record.n_refs);
+
+		g_hash_table_insert (files, g_strdup (content + record.path), file);
+	}
+
+	return map;
+}
+
+static void
+symboldb_append (GByteArray *table, GString *strings, GList *list, GHashTable *files)
+{
+	GList *iterator;
+
+	for (iterator = list; iterator; iterator = iterator->next) {
+		CSymbolDbFile record;
+		CSymbolFile *file;
+		gint i;
+
+		file = (CSymbolFile *) g_hash_table_lookup (files, iterator->data);
+		if (file == NULL || file->tags == NULL) {
+			continue;
+		}
+
+		memset (&record, 0, sizeof (CSymbolDbFile));
+		record.hash = file->hash;
+		record.mtime = file->mtime;
+		record.size = file->size;
+
+		record.path = strings->len;
+		g_string_append_len (strings, (const gchar *) iterator->data,
+							 strlen ((const gchar *) iterator->data) + 1);
+
+		record.tags = strings->len;
+		for (i = 0; file->tags[i]; i++) {
+			g_string_append_len (strings, file->tags[i], strlen (file->tags[i]) + 1);
+		}
+		record.n_tags = i;
+
+		record.refs = strings->len;
+		for (i = 0; file->refs != NULL && file->refs[i]; i++) {
+			g_string_append_len (strings, file->refs[i], strlen (file->refs[i]) + 1);
+		}
+		record.n_refs = i;
+
+		g_byte_array_append (table, (const guint8 *) &record, sizeof (CSymbolDbFile));
+	}
+}
+
+/* Writes the tags of every project file in files, in project order. */
+void
+symboldb_save (const gchar *project_path, GList *header_list, GList *source_list,
+			   GHashTable *files)
+{
+	CSymbolDbHeader header;
+	CSymbolDbFile *record;
+	GByteArray *table;
+	GString *strings;
+	GString *content;
+	gchar *path;
+	guint32 base;
+	guint i;
+
+	table = g_byte_array_new ();
+	strings = g_string_new (NULL);
+	symboldb_append (table, strings, header_list, files);
+	symboldb_append (table, strings, source_list, files);
+	/* Keeps the map nul terminated even without strings. */
+	g_string_append_c (strings, 0);
+
+	memset (&header, 0, sizeof (CSymbolDbHeader));
+	header.magic = SYMBOLDB_MAGIC;
+	header.version = SYMBOLDB_VERSION;
+	header.files = table->len / sizeof (CSymbolDbFile);
+
+	/* Offsets were taken relative to the string area. */
+	base = sizeof (CSymbolDbHeader) + table->len;
+	record = (CSymbolDbFile *) table->data;
+	for (i = 0; i < header.files; i++) {
+		record[i].path += base;
+		record[i].tags += base;
+		record[i].refs += base;
+	}
+
+	content = g_string_sized_new (base + strings->len);
+	g_string_append_len (content, (const gchar *) &header, sizeof (CSymbolDbHeader));
+	g_string_append_len (content, (const gchar *) table->data, table->len);
+	g_string_append_len (content, strings->str, strings->len);
+
+	path = symboldb_path (project_path);
+	if (!g_file_set_contents (path, content->str, content->len, NULL)) {
+		g_warning ("failed to write symbol database %s.", path);
+	}
+
+	g_free ((gpointer) path);
+	g_string_free (content, TRUE);
+	g_string_free (strings, TRUE);
+	g_byte_array_free (table, TRUE);
+}
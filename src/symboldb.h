@@ -0,0 +1,53 @@
+/*
+ * symboldb.h
+ * This file is part of codefox
+ *
+ * Copyright (C) 2012-2017 - Gordon Li
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef SYMBOLDB_H
+#define SYMBOLDB_H
+
+#include <gtk/gtk.h>
+
+/* Tags of one project file, kept between index runs so that only files
+ * whose content changed have to go through ctags again. The tag lines
+ * either live in data, the ctags output split in place, or point into a
+ * mapped database when data is NULL. The identifier uses found by
+ * xref_scan () are kept the same way in ref_data and refs.
+ */
+typedef struct {
+	gint64 mtime;
+	gint64 size;
+	guint64 hash;
+	guint tick;
+	gchar *data;
+	gchar **tags;
+	gchar *ref_data;
+	gchar **refs;
+} CSymbolFile;
+
+void
+symboldb_file_free (gpointer ptr);
+
+GMappedFile *
+symboldb_load (const gchar *project_path, GHashTable *files);
+
+void
+symboldb_save (const gchar *project_path, GList *header_list, GList *source_list,
+			   GHashTable *files);
+
+#endif /* SYMBOLDB_H */
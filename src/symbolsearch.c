@@ -0,0 +1,219 @@
+/*
+ * symbolsearch.c
+ * This file is part of codefox
+ *
+ * Copyright (C) 2012-2017 - Gordon Li
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifdef HAVE_CONFIG_H
+# include "config.h"
+#endif
+
+#include <glib/gi18n-lib.h>
+
+#include "symbolsearch.h"
+#include "symbol.h"
+
+/* Columns of the list store in codefox-symbol-search.ui. */
+enum {
+	SYMBOLSEARCH_COLUMN_NAME,
+	SYMBOLSEARCH_COLUMN_KIND,
+	SYMBOLSEARCH_COLUMN_LOCATION,
+	SYMBOLSEARCH_COLUMN_FILEPATH,
+	SYMBOLSEARCH_COLUMN_LINE,
+	SYMBOLSEARCH_COLUMNS
+};
+
+static const gchar *
+symbolsearch_kind_name (const gchar kind)
+{
+	switch (kind) {
+	case 'c':
+		return _("class");
+	case 'd':
+		return _("macro");
+	case 'e':
+		return _("enumerator");
+	case 'f':
+		return _("function");
+	case 'g':
+		return _("enum");
+	case 'm':
+		return _("member");
+	case 'n':
+		return _("namespace");
+	case 'p':
+		return _("prototype");
+	case 's':
+		return _("struct");
+	case 't':
+		return _("typedef");
+	case 'u':
+		return _("union");
+	case 'v':
+		return _("variable");
+	case 'x':
+		return _("external");
+	}
+
+	return "";
+}
+
+/* Every key stroke asks the index again, it answers from memory. */
+static void
+symbolsearch_on_changed (GtkEditable *editable, gpointer user_data)
+{
+	GtkTreeView *treeview;
+	GtkListStore *store;
+	GList *matches;
+	GList *iterator;
+	GtkTreeIter iter;
+
+	treeview = GTK_TREE_VIEW (user_data);
+	store = GTK_LIST_STORE (gtk_tree_view_get_model (treeview));
+	gtk_list_store_clear (store);
+
+	matches = symbol_search (gtk_entry_get_text (GTK_ENTRY (editable)), SYMBOLSEARCH_LIMIT);
+	for (iterator = matches; iterator; iterator = iterator->next) {
+		CSymbolMatch *match;
+		gchar *name;
+		gchar *basename;
+		gchar *location;
+
+		match = (CSymbolMatch *) iterator->data;
+		if (match->scope != NULL) {
+			name = g_strdup_printf ("%s::%s", match->scope, match->name);
+		}
+		else {
+			name = g_strdup (match->name);
+		}
+		basename = g_path_get_basename (match->filepath);
+		location = g_strdup_printf ("%s:%d", basename, match->line);
+
+		gtk_list_store_append (store, &iter);
+		gtk_list_store_set (store, &iter,
+							SYMBOLSEARCH_COLUMN_NAME, name,
+							SYMBOLSEARCH_COLUMN_KIND, symbolsearch_kind_name (match->kind),
+							SYMBOLSEARCH_COLUMN_LOCATION, location,
+							SYMBOLSEARCH_COLUMN_FILEPATH, match->filepath,
+							SYMBOLSEARCH_COLUMN_LINE, match->line,
+							-1);
+
+		g_free ((gpointer) name);
+		g_free ((gpointer) basename);
+		g_free ((gpointer) location);
+	}
+	g_list_free_full (matches, symbol_match_free);
+
+	if (gtk_tree_model_get_iter_first (GTK_TREE_MODEL (store), &iter)) {
+		gtk_tree_selection_select_iter (gtk_tree_view_get_selection (treeview), &iter);
+	}
+}
+
+/* Up and down walk the results without leaving the entry. */
+static gboolean
+symbolsearch_on_key_pressed (GtkWidget *widget, GdkEventKey *event, gpointer user_data)
+{
+	GtkTreeView *treeview;
+	GtkTreeSelection *selection;
+	GtkTreeModel *model;
+	GtkTreeIter iter;
+	GtkTreePath *path;
+
+	if (event->keyval != GDK_KEY_Up && event->keyval != GDK_KEY_Down) {
+		return FALSE;
+	}
+
+	treeview = GTK_TREE_VIEW (user_data);
+	selection = gtk_tree_view_get_selection (treeview);
+	if (!gtk_tree_selection_get_selected (selection, &model, &iter)) {
+		return TRUE;
+	}
+
+	path = gtk_tree_model_get_path (model, &iter);
+	if (event->keyval == GDK_KEY_Up) {
+		gtk_tree_path_prev (path);
+	}
+	else {
+		gtk_tree_path_next (path);
+	}
+	if (gtk_tree_model_get_iter (model, &iter, path)) {
+		gtk_tree_selection_select_iter (selection, &iter);
+		gtk_tree_view_scroll_to_cell (treeview, path, NULL, FALSE, 0.0, 0.0);
+	}
+	gtk_tree_path_free (path);
+
+	return TRUE;
+}
+
+static void
+symbolsearch_on_activate (GtkEntry *entry, gpointer user_data)
+{
+	gtk_dialog_response (GTK_DIALOG (user_data), 0);
+}
+
+static void
+symbolsearch_on_row_activated (GtkTreeView *treeview, GtkTreePath *path,
+							   GtkTreeViewColumn *column, gpointer user_data)
+{
+	gtk_dialog_response (GTK_DIALOG (user_data), 0);
+}
+
+/* Run the go to symbol dialog loaded into builder. On success filepath
+ * holds the file of the chosen symbol, to be freed by the caller, and line
+ * its line.
+ */
+gboolean
+symbolsearch_run (GtkBuilder *builder, GtkWindow *parent, gchar **filepath, gint *line)
+{
+	GObject *dialog;
+	GObject *entry;
+	GObject *treeview;
+	GtkTreeModel *model;
+	GtkTreeIter iter;
+	gboolean chosen;
+
+	dialog = gtk_builder_get_object (builder, "toplevel");
+	entry = gtk_builder_get_object (builder, "entry");
+	treeview = gtk_builder_get_object (builder, "treeview");
+	gtk_window_set_transient_for (GTK_WINDOW (dialog), parent);
+
+	g_signal_connect (entry, "changed",
+					  G_CALLBACK (symbolsearch_on_changed), treeview);
+	g_signal_connect (entry, "key-press-event",
+					  G_CALLBACK (symbolsearch_on_key_pressed), treeview);
+	g_signal_connect (entry, "activate",
+					  G_CALLBACK (symbolsearch_on_activate), dialog);
+	g_signal_connect (treeview, "row-activated",
+					  G_CALLBACK (symbolsearch_on_row_activated), dialog);
+
+	gtk_widget_grab_focus (GTK_WIDGET (entry));
+
+	chosen = FALSE;
+	if (gtk_dialog_run (GTK_DIALOG (dialog)) == 0 &&
+		gtk_tree_selection_get_selected (gtk_tree_view_get_selection (GTK_TREE_VIEW (treeview)),
+										 &model, &iter)) {
+		gtk_tree_model_get (model, &iter,
+							SYMBOLSEARCH_COLUMN_FILEPATH, filepath,
+							SYMBOLSEARCH_COLUMN_LINE, line,
+							-1);
+		chosen = TRUE;
+	}
+
+	gtk_widget_destroy (GTK_WIDGET (dialog));
+
+	return chosen;
+}
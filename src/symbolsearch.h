@@ -0,0 +1,32 @@
+/*
+ * symbolsearch.h
+ * This file is part of codefox
+ *
+ * Copyright (C) 2012-2017 - Gordon Li
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef SYMBOLSEARCH_H
+#define SYMBOLSEARCH_H
+
+#include <gtk/gtk.h>
+
+/* Rows shown for one query. */
+#define SYMBOLSEARCH_LIMIT 200
+
+gboolean
+symbolsearch_run (GtkBuilder *builder, GtkWindow *parent, gchar **filepath, gint *line);
+
+#endif /* SYMBOLSEARCH_H */
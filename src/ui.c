@@ -32,6 +32,7 @@
 #include "misc.h"
 #include "staticcheck.h"
 #include "symbol.h"
+#include "symbolsearch.h"
 #include "prefix.h"
 #include "editor.h"
 #include "editorconfig.h"
@@ -42,6 +43,10 @@
 #define PAGE_INFO 0
 #define PAGE_COMPILE 1
 #define PAGE_DEBUG 2
+#define PAGE_REFERENCE 4
+
+/* Rows the reference view takes per idle call. */
+#define REFERENCE_BATCH 256
 
 #define MESSAGE_BUF_SIZE 1000
 #define MAX_TIP_LENGTH 10000
@@ -73,6 +78,8 @@ static CFileTreeMenu *filetree_menu;
 static CFunctionTip *function_tip;
 static CMemberMenu *member_menu;
 static CPreferencesWindow *preferences_window;
+static GList *reference_pending;
+static guint reference_idle;
 
 static const gchar *license = 
 "Codefox is free software: you can redistribute it and/or modify\n"
@@ -162,6 +169,14 @@ signal_connect ()
 					  G_CALLBACK (on_open_project), NULL);
 	g_signal_connect (window->format_item, "activate", 
 					  G_CALLBACK (format_format_code), NULL);
+	g_signal_connect (window->symbol_item, "activate", 
+					  G_CALLBACK (on_symbol_search_clicked), NULL);
+	g_signal_connect (window->references_item, "activate", 
+					  G_CALLBACK (on_xref_clicked), XREF_WIDGET_REFERENCES);
+	g_signal_connect (window->callers_item, "activate", 
+					  G_CALLBACK (on_xref_clicked), XREF_WIDGET_CALLERS);
+	g_signal_connect (window->callees_item, "activate", 
+					  G_CALLBACK (on_xref_clicked), XREF_WIDGET_CALLEES);
 	g_signal_connect (window->build_item, "activate", 
 					  G_CALLBACK (build_compile), BUILD_WIDGET_COMPILE);
 	g_signal_connect (window->clear_item, "activate", 
@@ -232,6 +247,8 @@ signal_connect ()
 							G_CALLBACK (on_filetree_clicked), NULL);
 	g_signal_connect (window->filetree, "row-activated", 
 					  G_CALLBACK (on_filetree_2clicked), NULL);
+	g_signal_connect (window->referencetree, "row-activated", 
+					  G_CALLBACK (on_referencetree_activated), NULL);
 }
 
 /* Get all widgets in the builder by name*/
@@ -256,6 +273,10 @@ ui_window_init (GtkBuilder *builder, CWindow *window)
 	window->new_project_item =  gtk_builder_get_object (builder, "newprojectmenuitem");
 	window->open_project_item =  gtk_builder_get_object (builder, "openprojectmenuitem");
 	window->format_item =  gtk_builder_get_object (builder, "formatmenuitem");
+	window->symbol_item =  gtk_builder_get_object (builder, "symbolmenuitem");
+	window->references_item =  gtk_builder_get_object (builder, "referencesmenuitem");
+	window->callers_item =  gtk_builder_get_object (builder, "callersmenuitem");
+	window->callees_item =  gtk_builder_get_object (builder, "calleesmenuitem");
 	window->build_item =  gtk_builder_get_object (builder, "buildmenuitem");
 	window->clear_item =  gtk_builder_get_object (builder, "clearmenuitem");
 	window->run_item =  gtk_builder_get_object (builder, "runmenuitem");
@@ -286,6 +307,7 @@ ui_window_init (GtkBuilder *builder, CWindow *window)
 	window->vertical_paned = gtk_builder_get_object (builder, "verpaned");
 	window->statustree = gtk_builder_get_object (builder, "statustree");
 	window->compilertree = gtk_builder_get_object (builder, "compilertree");
+	window->referencetree = gtk_builder_get_object (builder, "referencetree");
 	window->notepadview = gtk_builder_get_object (builder, "notepadview");
 	window->projectlabel = gtk_builder_get_object (builder, "projectlabel");
 	window->locationlabel = gtk_builder_get_object (builder, "locationlabel");
@@ -305,13 +327,14 @@ ui_filetree_init (CWindow *window)
 	filetree_init (GTK_TREE_VIEW (window->filetree));
 }
 
-/* Initialize the status view and notepad. */
+/* Initialize the status view, the reference view and notepad. */
 static void
 ui_toolpad_init (CWindow *window)
 {
 	GtkTextBuffer *buffer;
 	gchar time[MAX_TIME_LENGTH + 1];
 	GtkTreeStore *store;
+	GtkListStore *list_store;
 	GtkCellRenderer *renderer;
 	GtkTreeViewColumn *column;
 	GtkTreeSelection *select;
@@ -358,6 +381,25 @@ ui_toolpad_init (CWindow *window)
 	gtk_tree_view_set_model (GTK_TREE_VIEW (window->compilertree), GTK_TREE_MODEL (store));
 	select = gtk_tree_view_get_selection (GTK_TREE_VIEW(window->compilertree));
 	gtk_tree_selection_set_mode (select, GTK_SELECTION_SINGLE);
+
+	list_store = gtk_list_store_new (4, G_TYPE_STRING, G_TYPE_STRING, G_TYPE_STRING, G_TYPE_INT);
+	column = gtk_tree_view_column_new ();
+	gtk_tree_view_column_set_title (column, _("Function:"));
+	renderer = gtk_cell_renderer_text_new ();
+	gtk_tree_view_column_pack_start (column, renderer, FALSE);
+	gtk_tree_view_column_add_attribute(column, renderer, "text", 0);
+	gtk_tree_view_column_set_resizable (column, TRUE);
+	gtk_tree_view_append_column (GTK_TREE_VIEW (window->referencetree), column);
+	column = gtk_tree_view_column_new ();
+	gtk_tree_view_column_set_title (column, _("Location:"));
+	renderer = gtk_cell_renderer_text_new ();
+	gtk_tree_view_column_pack_start (column, renderer, FALSE);
+	gtk_tree_view_column_add_attribute(column, renderer, "text", 1);
+	gtk_tree_view_append_column (GTK_TREE_VIEW (window->referencetree), column);
+	gtk_tree_view_set_model (GTK_TREE_VIEW (window->referencetree), GTK_TREE_MODEL (list_store));
+	g_object_unref (list_store);
+	select = gtk_tree_view_get_selection (GTK_TREE_VIEW(window->referencetree));
+	gtk_tree_selection_set_mode (select, GTK_SELECTION_SINGLE);
 	
 	buffer = gtk_text_view_get_buffer (GTK_TEXT_VIEW (window->notepadview));
 	gtk_text_buffer_set_text (buffer, _("Write down any notes you want here..."), -1);
@@ -742,14 +784,11 @@ ui_editor_new ()
 	ui_preferences_config_update ();
 }
 
-/* Create a new editor with code and show it. */
-void
-ui_editor_new_with_text (const gchar *filepath, const gchar *code_buf)
+static void
+ui_editor_add (CEditor *new_editor)
 {
-	CEditor *new_editor;
 	gint index;
 
-	new_editor = ceditor_new_with_text (filepath, code_buf);
 	ceditor_show (new_editor);
 	ceditor_recover_breakpoint (new_editor);
 	window->editor_list = g_list_append (window->editor_list, new_editor);
@@ -772,6 +811,46 @@ ui_editor_new_with_text (const gchar *filepath, const gchar *code_buf)
 	ui_preferences_config_update ();
 }
 
+/* Create a new editor with code and show it. */
+void
+ui_editor_new_with_text (const gchar *filepath, const gchar *code_buf)
+{
+	ui_editor_add (ceditor_new_with_text (filepath, code_buf));
+}
+
+/* Open filepath in a new editor, large files are streamed into it. */
+void
+ui_editor_new_with_file (const gchar *filepath)
+{
+	const CEditorConfig *editor_config;
+	CEditor *new_editor;
+	gchar *code_buf;
+
+	editor_config = editorconfig_config_get ();
+
+	if (misc_get_file_size (filepath) > editor_config->large_file_size) {
+		new_editor = ceditor_new_with_file (filepath);
+		if (new_editor == NULL) {
+			gchar *message;
+
+			message = g_strdup_printf (_("failed to open %s."), filepath);
+			ui_status_entry_new (FILE_OP_ERROR, message);
+			g_free ((gpointer) message);
+
+			return;
+		}
+
+		ui_editor_add (new_editor);
+
+		return;
+	}
+
+	misc_get_file_content (filepath, &code_buf);
+	ui_editor_add (ceditor_new_with_text (filepath, code_buf));
+
+	g_free ((gpointer) code_buf);
+}
+
 /* Add a new entry to filetree. */
 void
 ui_filetree_entry_new (gboolean is_file, gchar *filename, gchar *filepath)
@@ -1489,6 +1568,28 @@ ui_confirm_dialog_new (const gchar *message)
 	return ret;
 }
 
+gboolean
+ui_symbol_search_dialog_run (gchar **filepath, gint *line)
+{
+	GtkBuilder *builder;
+	gchar *data_dir;
+	gchar *template_file;
+	gboolean chosen;
+
+	builder = gtk_builder_new ();
+	data_dir = g_build_filename (CODEFOX_DATADIR, "codefox", NULL);
+	template_file = g_build_filename (data_dir, "codefox-symbol-search.ui", NULL);
+	gtk_builder_add_from_file (builder, template_file, NULL);
+
+	g_free ((gpointer) data_dir);
+	g_free ((gpointer) template_file);
+
+	chosen = symbolsearch_run (builder, GTK_WINDOW (window->toplevel), filepath, line);
+	g_object_unref (builder);
+
+	return chosen;
+}
+
 gint
 ui_filetree_row_second_level ()
 {
@@ -2030,39 +2131,77 @@ ui_status_image_set (const gboolean error, const gboolean warning)
 	}
 }
 
+static CHighlightCache *
+ui_highlight_cache_get (GtkTextBuffer *textbuffer)
+{
+	GList *iterator;
+
+	for (iterator = window->editor_list; iterator; iterator = iterator->next) {
+		CEditor *editor;
+
+		editor = (CEditor *) iterator->data;
+		if (gtk_text_view_get_buffer (GTK_TEXT_VIEW (editor->textview)) == textbuffer) {
+			return editor->highlight_cache;
+		}
+	}
+
+	return NULL;
+}
+
+void
+ui_highlight_before_delete (GtkTextBuffer *textbuffer, GtkTextIter *start,
+							GtkTextIter *end)
+{
+	/* Lines in the range are about to be joined into the first one. */
+	CHighlightCache *cache;
+	gint start_line, end_line;
+
+	cache = ui_highlight_cache_get (textbuffer);
+	if (cache == NULL) {
+		return;
+	}
+
+	start_line = gtk_text_iter_get_line (start);
+	end_line = gtk_text_iter_get_line (end);
+
+	highlight_cache_remove_lines (cache, start_line, end_line - start_line);
+}
+
 void
 ui_highlight_on_delete (GtkTextBuffer *textbuffer, GtkTextIter *start,
 						 GtkTextIter *end)
 {
-	
-	GtkTextIter startitr, enditr;
-	gint start_line, end_line;
+	CHighlightCache *cache;
+	gint start_line;
+
+	cache = ui_highlight_cache_get (textbuffer);
+	if (cache == NULL) {
+		return;
+	}
 	
 	start_line = gtk_text_iter_get_line (start);
-	end_line = gtk_text_iter_get_line (end);
-	gtk_text_buffer_get_iter_at_line (textbuffer, &startitr, start_line);
-	gtk_text_buffer_get_iter_at_line (textbuffer, &enditr, end_line);
-	gtk_text_iter_forward_to_line_end (&enditr);
+	highlight_cache_invalidate (cache, start_line, start_line);
 	
-	highlight_apply (textbuffer, &startitr, &enditr);
+	highlight_update (cache);
 }
 
 void
 ui_highlight_on_insert (GtkTextBuffer *textbuffer, GtkTextIter *location, gint lines, gint *end_line_ptr)
 {
-	
-	GtkTextIter start, end;
+	CHighlightCache *cache;
 	gint start_line, end_line;
 
 	end_line = gtk_text_iter_get_line (location);
 	start_line = end_line - lines;
 	*end_line_ptr = end_line;
 
-	gtk_text_buffer_get_iter_at_line (textbuffer, &start, start_line);
-	gtk_text_buffer_get_iter_at_line (textbuffer, &end, end_line);
-	gtk_text_iter_forward_to_line_end (&end);
+	cache = ui_highlight_cache_get (textbuffer);
+	if (cache == NULL) {
+		return;
+	}
 
-	highlight_apply (textbuffer, &start, &end);
+	highlight_cache_insert_lines (cache, start_line, lines);
+	highlight_update (cache);
 }
 
 void
@@ -2449,6 +2588,124 @@ ui_current_editor_move_cursor (const gint offset)
 	ceditor_move_corsor (editor, offset);
 }
 
+void
+ui_current_editor_word (gchar *word, const gint size)
+{
+	CEditor *editor;
+
+	word[0] = 0;
+	editor = ui_get_current_editor ();
+
+	if (editor == NULL) {
+		return;
+	}
+
+	ceditor_word_at_cursor (editor, word, size);
+}
+
+/* Show filepath at line, opening it first if it is not open yet. */
+void
+ui_editor_open_at (const gchar *filepath, const gint line)
+{
+	if (!ui_find_editor (filepath)) {
+		ui_editor_new_with_file (filepath);
+	}
+	ui_select_editor_with_path (filepath);
+	ui_current_editor_goto_line (line);
+}
+
+/* Appends the next batch of pending matches, so that a symbol used all
+ * over the project fills the view without holding up the main loop.
+ */
+static gboolean
+ui_reference_view_stream (gpointer data)
+{
+	GtkListStore *store;
+	gint n;
+
+	store = GTK_LIST_STORE (gtk_tree_view_get_model (GTK_TREE_VIEW (window->referencetree)));
+	for (n = 0; reference_pending != NULL && n < REFERENCE_BATCH; n++) {
+		CSymbolMatch *match;
+		GtkTreeIter iter;
+		gchar *function;
+		gchar *location;
+
+		match = (CSymbolMatch *) reference_pending->data;
+		reference_pending = g_list_delete_link (reference_pending, reference_pending);
+
+		if (match->scope != NULL) {
+			function = g_strdup_printf ("%s::%s", match->scope, match->name);
+		}
+		else {
+			function = g_strdup (match->name[0]? match->name: _("(file scope)"));
+		}
+		location = g_strdup_printf ("%s:%d", match->filepath, match->line);
+
+		gtk_list_store_append (store, &iter);
+		gtk_list_store_set (store, &iter, 0, function, 1, location,
+							2, match->filepath, 3, match->line, -1);
+
+		g_free ((gpointer) function);
+		g_free ((gpointer) location);
+		symbol_match_free (match);
+	}
+
+	if (reference_pending == NULL) {
+		reference_idle = 0;
+
+		return FALSE;
+	}
+
+	return TRUE;
+}
+
+/* Replace the content of the reference view with matches, taking them. */
+void
+ui_reference_view_show (GList *matches)
+{
+	GtkListStore *store;
+
+	store = GTK_LIST_STORE (gtk_tree_view_get_model (GTK_TREE_VIEW (window->referencetree)));
+	gtk_list_store_clear (store);
+	g_list_free_full (reference_pending, symbol_match_free);
+	reference_pending = matches;
+
+	if (reference_pending != NULL && reference_idle == 0) {
+		reference_idle = g_idle_add (ui_reference_view_stream, NULL);
+	}
+
+	gtk_notebook_set_current_page (GTK_NOTEBOOK (window->info_notebook), PAGE_REFERENCE);
+}
+
+gboolean
+ui_reference_view_get (GtkTreePath *path, gchar **filepath, gint *line)
+{
+	GtkTreeModel *model;
+	GtkTreeIter iter;
+
+	model = gtk_tree_view_get_model (GTK_TREE_VIEW (window->referencetree));
+	if (!gtk_tree_model_get_iter (model, &iter, path)) {
+		return FALSE;
+	}
+	gtk_tree_model_get (model, &iter, 2, filepath, 3, line, -1);
+
+	return TRUE;
+}
+
+void
+ui_current_editor_goto_line (const gint line)
+{
+	CEditor *editor;
+
+	editor = ui_get_current_editor ();
+
+	if (editor == NULL) {
+		return;
+	}
+
+	ceditor_goto_line (editor, line);
+}
+
 gboolean
 ui_current_editor_get_need_highlight()
 {
@@ -2463,6 +2720,66 @@ ui_current_editor_get_need_highlight()
 	return ceditor_get_need_highlight(editor);
 }
 
+gboolean
+ui_current_editor_large_file ()
+{
+	CEditor *editor;
+
+	editor = ui_get_current_editor ();
+
+	if (editor == NULL) {
+		return FALSE;
+	}
+
+	return editor->large_file;
+}
+
+/* The current file is still streaming into its buffer. */
+gboolean
+ui_current_editor_loading ()
+{
+	CEditor *editor;
+
+	editor = ui_get_current_editor ();
+
+	if (editor == NULL) {
+		return FALSE;
+	}
+
+	return editor->load != NULL;
+}
+
+gboolean
+ui_current_editor_local_type (const gchar *name, const gint lineno, const gboolean isptr,
+							  gchar *type, const gint size)
+{
+	CEditor *editor;
+
+	editor = ui_get_current_editor ();
+
+	if (editor == NULL) {
+		type[0] = 0;
+
+		return FALSE;
+	}
+
+	return localdecl_find_type (editor->local_index, name, lineno, isptr, type, size);
+}
+
+void
+ui_current_editor_autoindent_later (const gint line)
+{
+	CEditor *editor;
+
+	editor = ui_get_current_editor ();
+
+	if (editor == NULL) {
+		return;
+	}
+
+	ceditor_autoindent_later (editor, line);
+}
+
 void
 ui_current_editor_set_need_highlight(gboolean need)
 {
@@ -38,6 +38,10 @@
 #define BUILD_WIDGET_COMPILE "compile"
 #define BUILD_WIDGET_CLEAR "clear"
 
+#define XREF_WIDGET_REFERENCES "references"
+#define XREF_WIDGET_CALLERS "callers"
+#define XREF_WIDGET_CALLEES "callees"
+
 
 typedef struct {
 	GObject *toplevel;
@@ -58,6 +62,10 @@ typedef struct {
 	GObject *new_project_item;
 	GObject *open_project_item;
 	GObject *format_item;
+	GObject *symbol_item;
+	GObject *references_item;
+	GObject *callers_item;
+	GObject *callees_item;
 	GObject *build_item;
 	GObject *run_item;
 	GObject *debug_item;
@@ -85,6 +93,7 @@ typedef struct {
 	GObject *info_notebook;
 	GObject *statustree;
 	GObject *compilertree;
+	GObject *referencetree;
 	GObject *notepadview;
 	GObject *projectlabel;
 	GObject *locationlabel;
@@ -234,6 +243,9 @@ ui_editor_new ();
 void
 ui_editor_new_with_text (const gchar *filepath, const gchar *code_buf);
 
+void
+ui_editor_new_with_file (const gchar *filepath);
+
 void
 ui_filetree_entry_new (gboolean is_file, gchar *filename, gchar *filepath);
 
@@ -338,6 +350,9 @@ ui_error_dialog_new (const gchar *message);
 gint
 ui_confirm_dialog_new (const gchar *message);
 
+gboolean
+ui_symbol_search_dialog_run (gchar **filepath, gint *line);
+
 gint
 ui_filetree_row_second_level ();
 
@@ -410,6 +425,10 @@ ui_current_editor_set_dirty ();
 void
 ui_status_image_set (const gboolean error, const gboolean warning);
 
+void
+ui_highlight_before_delete (GtkTextBuffer *textbuffer, GtkTextIter *start,
+							GtkTextIter *end);
+
 void
 ui_highlight_on_delete (GtkTextBuffer *textbuffer, GtkTextIter *start,
 						 GtkTextIter *end);
@@ -515,10 +534,38 @@ ui_editor_close_by_path (const gchar *filepath);
 void
 ui_current_editor_move_cursor (const gint offset);
 
+void
+ui_current_editor_goto_line (const gint line);
+
+void
+ui_current_editor_word (gchar *word, const gint size);
+
+void
+ui_editor_open_at (const gchar *filepath, const gint line);
+
+void
+ui_reference_view_show (GList *matches);
+
+gboolean
+ui_reference_view_get (GtkTreePath *path, gchar **filepath, gint *line);
+
 gboolean
 ui_current_editor_get_need_highlight();
 
 void
 ui_current_editor_set_need_highlight(gboolean need);
 
+gboolean
+ui_current_editor_large_file ();
+
+gboolean
+ui_current_editor_loading ();
+
+gboolean
+ui_current_editor_local_type (const gchar *name, const gint lineno, const gboolean isptr,
+							  gchar *type, const gint size);
+
+void
+ui_current_editor_autoindent_later (const gint line);
+
 #endif /* UI_H */
@@ -0,0 +1,204 @@
+/*
+ * xref.c
+ * This file is part of codefox
+ *
+ * Copyright (C) 2012-2017 - Gordon Li
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <string.h>
+
+#include "xref.h"
+#include "keywords.h"
+
+/* Uses of one identifier in the scanned file. */
+typedef struct {
+	GString *lines;
+	gint last_line;
+	gboolean last_call;
+} CXrefEntry;
+
+static void
+xref_entry_free (gpointer data)
+{
+	CXrefEntry *entry = (CXrefEntry *) data;
+
+	g_string_free (entry->lines, TRUE);
+	g_free (data);
+}
+
+static void
+xref_add (GHashTable *entries, GPtrArray *names, const gchar *name, const gint len,
+		  const gint line, const gboolean call)
+{
+	CXrefEntry *entry;
+	gchar *key;
+
+	key = g_strndup (name, len);
+	entry = (CXrefEntry *) g_hash_table_lookup (entries, key);
+	if (entry == NULL) {
+		entry = (CXrefEntry *) g_malloc (sizeof (CXrefEntry));
+		entry->lines = g_string_new (NULL);
+		entry->last_line = 0;
+		entry->last_call = FALSE;
+		g_hash_table_insert (entries, key, entry);
+		g_ptr_array_add (names, key);
+	}
+	else {
+		g_free ((gpointer) key);
+	}
+
+	if (entry->last_line != line) {
+		if (entry->lines->len > 0) {
+			g_string_append_c (entry->lines, ' ');
+		}
+		g_string_append_printf (entry->lines, "%d", line);
+		entry->last_line = line;
+		entry->last_call = FALSE;
+	}
+	if (call && !entry->last_call) {
+		g_string_append_c (entry->lines, 'c');
+		entry->last_call = TRUE;
+	}
+}
+
+/* Skips a quoted literal starting at p, counting the lines it spans. */
+static const gchar *
+xref_skip_quoted (const gchar *p, const gchar *end, gint *line)
+{
+	gchar quote;
+
+	quote = *p++;
+	while (p < end && *p != quote) {
+		if (*p == '\\' && p + 1 < end) {
+			p++;
+		}
+		if (*p == '\n') {
+			(*line)++;
+		}
+		p++;
+	}
+
+	return p < end? p + 1: end;
+}
+
+/* Lists every identifier used in content, keywords aside, with the lines
+ * it appears on; comments, literals and include lines are skipped. One
+ * line per identifier, in order of first use:
+ *   name <tab> line line...
+ * where a line number followed by 'c' holds a call, the name followed by
+ * an opening parenthesis.
+ */
+gchar *
+xref_scan (const gchar *content, const gsize len)
+{
+	GHashTable *entries;
+	GPtrArray *names;
+	GString *result;
+	const gchar *p;
+	const gchar *end;
+	gboolean line_start;
+	gint line;
+	guint i;
+
+	entries = g_hash_table_new_full (g_str_hash, g_str_equal, g_free, xref_entry_free);
+	names = g_ptr_array_new ();
+
+	p = content;
+	end = content + len;
+	line = 1;
+	line_start = TRUE;
+	while (p < end) {
+		const gchar *word;
+		const gchar *q;
+
+		if (*p == '\n') {
+			line++;
+			line_start = TRUE;
+			p++;
+			continue;
+		}
+		if (*p == ' ' || *p == '\t' || *p == '\r') {
+			p++;
+			continue;
+		}
+
+		if (*p == '#' && line_start) {
+			for (q = p + 1; q < end && (*q == ' ' || *q == '\t'); q++) {
+			}
+			if (end - q >= 7 && memcmp (q, "include", 7) == 0) {
+				p = memchr (q, '\n', end - q);
+				if (p == NULL) {
+					break;
+				}
+				continue;
+			}
+		}
+		line_start = FALSE;
+
+		if (*p == '/' && p + 1 < end && p[1] == '/') {
+			p = memchr (p, '\n', end - p);
+			if (p == NULL) {
+				break;
+			}
+		}
+		else if (*p == '/' && p + 1 < end && p[1] == '*') {
+			for (p += 2; p < end && !(*p == '*' && p + 1 < end && p[1] == '/'); p++) {
+				if (*p == '\n') {
+					line++;
+				}
+			}
+			p = MIN (p + 2, end);
+		}
+		else if (*p == '"' || *p == '\'') {
+			p = xref_skip_quoted (p, end, &line);
+		}
+		else if (g_ascii_isdigit (*p)) {
+			for (p++; p < end && (g_ascii_isalnum (*p) || *p == '_' || *p == '.'); p++) {
+			}
+		}
+		else if (g_ascii_isalpha (*p) || *p == '_') {
+			word = p;
+			for (p++; p < end && (g_ascii_isalnum (*p) || *p == '_'); p++) {
+			}
+			if (keywords_is_keyword (word, p - word, KEYWORDS_C | KEYWORDS_CPP)) {
+				continue;
+			}
+
+			for (q = p; q < end && (*q == ' ' || *q == '\t'); q++) {
+			}
+			xref_add (entries, names, word, p - word, line, q < end && *q == '(');
+		}
+		else {
+			p++;
+		}
+	}
+
+	result = g_string_new (NULL);
+	for (i = 0; i < names->len; i++) {
+		CXrefEntry *entry;
+
+		entry = (CXrefEntry *) g_hash_table_lookup (entries, names->pdata[i]);
+		g_string_append (result, (const gchar *) names->pdata[i]);
+		g_string_append_c (result, '\t');
+		g_string_append_len (result, entry->lines->str, entry->lines->len);
+		g_string_append_c (result, '\n');
+	}
+
+	g_ptr_array_free (names, TRUE);
+	g_hash_table_destroy (entries);
+
+	return g_string_free (result, FALSE);
+}